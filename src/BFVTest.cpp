@@ -67,7 +67,8 @@ void bfv_bench() {
     auto start = chrono::high_resolution_clock::now();
     // encode and encrypt small batch of numbers
     for (int i = 0; i < SIZE; i ++) {   
-        Plaintext plain(uint64_to_hex_string(random_arr[i]));
+        Plaintext plain;
+        set_constant_plain(random_arr[i], plain);
         encryptor.encrypt(plain, cipher);
     }
     // timing this small test
@@ -80,7 +81,8 @@ void bfv_bench() {
     int encrypt_time = duration.count();
 
     // timing some number of additions
-    Plaintext plain_one(uint64_to_hex_string(1));
+    Plaintext plain_one;
+    set_constant_plain(1, plain_one);
     Ciphertext cipher_one;
     encryptor.encrypt(plain_one, cipher_one);
 
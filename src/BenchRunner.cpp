@@ -0,0 +1,422 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "seal/seal.h"
+#include "racheal.h"
+#include "inche.h"
+#include "keycontext.h"
+#include "threadpool.h"
+#include "utils.h"
+#include "bench.h"
+#include "benchreport.h"
+
+using namespace std;
+using namespace seal;
+using namespace racheal;
+using namespace inche;
+using namespace che_utils;
+
+/**
+ * Non-interactive benchmark driver, used whenever bench is given any arguments.
+ * Every operation is timed per call (or per batch) over several repetitions, and
+ * the results are printed as JSON so they can be stored and compared later.
+ *
+ * Usage: benchmarks --engine seal|rache|inche [--scheme ckks|bfv|bgv] [--degree N]
+ *                   [--radix r] [--cache size] [--min value] [--max value]
+ *                   [--values count] [--threads count] [--reps count] [--seed seed]
+ *                   [--output file] [--baseline file] [--threshold fraction]
+ *                   [--pool global|thread] [--huge-pages none|transparent|hugetlb]
+ *                   [--memo capacity]
+ */
+namespace {
+    struct BenchConfig {
+        string engine = "rache";
+        string scheme = "ckks";
+        size_t degree = 32768;
+        uint32_t radix = 2;
+        size_t cache_size = 10;
+        uint64_t min_val = 1;
+        uint64_t max_val = 1023;
+        size_t nb_values = 1024;
+        unsigned threads = 0;
+        size_t reps = 5;
+        uint64_t seed = 0;
+        string output;
+        string baseline;
+        double threshold = 0.1;
+        string pool = "global";
+        string pages = "none";
+        size_t memo = 0;
+    };
+
+    // timings of one operation in microseconds, batches are recorded per value
+    using Samples = vector<double>;
+
+    const char *USAGE =
+        "Usage: benchmarks --engine seal|rache|inche [--scheme ckks|bfv|bgv] [--degree N]\n"
+        "                  [--radix r] [--cache size] [--min value] [--max value]\n"
+        "                  [--values count] [--threads count] [--reps count] [--seed seed]\n"
+        "                  [--output file] [--baseline file] [--threshold fraction]\n"
+        "                  [--pool global|thread] [--huge-pages none|transparent|hugetlb]\n"
+        "                  [--memo capacity]";
+
+    scheme_type parse_scheme(const string &name) {
+        if (name == "ckks") {
+            return scheme_type::ckks;
+        } else if (name == "bfv") {
+            return scheme_type::bfv;
+        } else if (name == "bgv") {
+            return scheme_type::bgv;
+        }
+        throw invalid_argument("Unknown scheme: " + name);
+    }
+
+    huge_pages parse_huge_pages(const string &name) {
+        if (name == "none") {
+            return huge_pages::none;
+        } else if (name == "transparent") {
+            return huge_pages::transparent;
+        } else if (name == "hugetlb") {
+            return huge_pages::hugetlb;
+        }
+        throw invalid_argument("Unknown huge page mode: " + name);
+    }
+
+    BenchConfig parse_args(int argc, char **argv) {
+        BenchConfig config;
+        config.seed = chrono::system_clock::now().time_since_epoch().count();
+        for (int i = 1; i < argc; i += 2) {
+            string flag = argv[i];
+            if (i + 1 >= argc) {
+                throw invalid_argument("Missing value for " + flag);
+            }
+
+            string arg = argv[i + 1];
+            if (flag == "--engine") {
+                config.engine = arg;
+            } else if (flag == "--scheme") {
+                config.scheme = arg;
+            } else if (flag == "--degree") {
+                config.degree = stoul(arg);
+            } else if (flag == "--radix") {
+                config.radix = stoul(arg);
+            } else if (flag == "--cache") {
+                config.cache_size = stoul(arg);
+            } else if (flag == "--min") {
+                config.min_val = stoull(arg);
+            } else if (flag == "--max") {
+                config.max_val = stoull(arg);
+            } else if (flag == "--values") {
+                config.nb_values = stoul(arg);
+            } else if (flag == "--threads") {
+                config.threads = stoul(arg);
+            } else if (flag == "--reps") {
+                config.reps = stoul(arg);
+            } else if (flag == "--seed") {
+                config.seed = stoull(arg);
+            } else if (flag == "--output") {
+                config.output = arg;
+            } else if (flag == "--baseline") {
+                config.baseline = arg;
+            } else if (flag == "--threshold") {
+                config.threshold = stod(arg);
+            } else if (flag == "--pool") {
+                config.pool = arg;
+            } else if (flag == "--huge-pages") {
+                config.pages = arg;
+            } else if (flag == "--memo") {
+                config.memo = stoul(arg);
+            } else {
+                throw invalid_argument("Unknown option: " + flag);
+            }
+        }
+
+        parse_scheme(config.scheme);
+        if (config.engine != "seal" && config.engine != "rache" && config.engine != "inche") {
+            throw invalid_argument("Unknown engine: " + config.engine);
+        }
+        if (config.pool != "global" && config.pool != "thread") {
+            throw invalid_argument("Unknown pool: " + config.pool);
+        }
+        parse_huge_pages(config.pages);
+        if (config.min_val > config.max_val || config.nb_values == 0 || config.reps == 0) {
+            throw invalid_argument("Need min <= max and at least one value and repetition");
+        }
+        return config;
+    }
+
+    EncryptionParameters make_params(const BenchConfig &config) {
+        EncryptionParameters params(parse_scheme(config.scheme));
+        params.set_poly_modulus_degree(config.degree);
+        params.set_coeff_modulus(CoeffModulus::BFVDefault(config.degree));
+        if (params.scheme() != scheme_type::ckks) {
+            params.set_plain_modulus(PlainModulus::Batching(config.degree, 30));
+        }
+        return params;
+    }
+
+    // nearest-rank percentile of sorted samples
+    double percentile(const vector<double> &sorted, double p) {
+        size_t rank = ceil(p / 100 * sorted.size());
+        return sorted[max<size_t>(rank, 1) - 1];
+    }
+
+    OpStats summarize(Samples samples) {
+        sort(samples.begin(), samples.end());
+        double total = 0;
+        for (double micros : samples) {
+            total += micros;
+        }
+
+        OpStats stats;
+        stats.mean_us = total / samples.size();
+        stats.p50_us = percentile(samples, 50);
+        stats.p99_us = percentile(samples, 99);
+        stats.throughput = total > 0 ? samples.size() / (total / 1e6) : 0;
+        return stats;
+    }
+
+    template <typename Op>
+    double time_us(Op op) {
+        auto start = chrono::high_resolution_clock::now();
+        op();
+        auto stop = chrono::high_resolution_clock::now();
+        return chrono::duration<double, micro>(stop - start).count();
+    }
+
+    // the SEAL baseline, a fresh public-key encryption per value, batches spread over the pool
+    class SealEngine {
+    public:
+        explicit SealEngine(shared_ptr<const KeyContext> keys) : keys(keys), encryptor(keys->context(), keys->public_key()) {
+            if (keys->params().scheme() == scheme_type::ckks) {
+                encoder.reset(new CKKSEncoder(keys->context()));
+                auto &coeffs = keys->params().coeff_modulus();
+                scale = pow(2.0, log2(*(coeffs[min<size_t>(2, coeffs.size() - 1)].data())));
+            }
+        }
+
+        void encrypt(double value, Ciphertext &destination) {
+            encrypt(value, destination, plain);
+        }
+
+        void encrypt_batch(const vector<double> &values, vector<Ciphertext> &destination) {
+            destination.resize(values.size());
+            parallel_for(values.size(), [&](int start, int end) {
+                Plaintext chunk_plain;
+                for (int i = start; i < end; i++) {
+                    encrypt(values[i], destination[i], chunk_plain);
+                }
+            });
+        }
+
+    private:
+        // the encryptor and encoder are safe to share, the plaintext is not
+        void encrypt(double value, Ciphertext &destination, Plaintext &scratch) const {
+            if (encoder) {
+                encoder->encode(value, scale, scratch);
+            } else {
+                set_constant_plain(value, scratch);
+            }
+            encryptor.encrypt(scratch, destination);
+        }
+
+        shared_ptr<const KeyContext> keys;
+        Encryptor encryptor;
+        unique_ptr<CKKSEncoder> encoder;
+        Plaintext plain;
+        double scale = 0;
+    };
+
+    template <typename Engine>
+    void run_engine(Engine &engine, const BenchConfig &config, const vector<double> &values,
+                    map<string, Samples> &samples, const KeyContext &keys) {
+        Evaluator evaluator(keys.context());
+        Decryptor decryptor(keys.context(), keys.secret_key());
+        vector<Ciphertext> ctxts(values.size());
+        Plaintext plain;
+
+        for (size_t rep = 0; rep < config.reps; rep++) {
+            cerr << "repetition " << rep + 1 << "/" << config.reps << endl;
+
+            auto &encrypt = samples["encrypt"];
+            for (size_t i = 0; i < values.size(); i++) {
+                encrypt.push_back(time_us([&] { engine.encrypt(values[i], ctxts[i]); }));
+            }
+
+            // one sample per batch, spread over its values
+            auto &batch = samples["encrypt_batch"];
+            batch.push_back(time_us([&] { engine.encrypt_batch(values, ctxts); }) / values.size());
+
+            auto &decrypt = samples["decrypt"];
+            for (auto &ctxt : ctxts) {
+                decrypt.push_back(time_us([&] { decryptor.decrypt(ctxt, plain); }));
+            }
+
+            // adds into a copy so the ciphertexts themselves stay fresh
+            auto &add = samples["add"];
+            Ciphertext sum = ctxts[0];
+            for (size_t i = 1; i < ctxts.size(); i++) {
+                add.push_back(time_us([&] { evaluator.add_inplace(sum, ctxts[i]); }));
+            }
+        }
+    }
+
+    // the mean of every operation in a report written by this runner
+    map<string, double> read_baseline(const string &path) {
+        ifstream in(path);
+        if (!in.is_open()) {
+            throw runtime_error("Failed to open baseline: " + path);
+        }
+        stringstream buffer;
+        buffer << in.rdbuf();
+
+        BenchReport report;
+        try {
+            report = read_bench_report(buffer.str());
+        } catch (const invalid_argument &e) {
+            throw invalid_argument("Invalid baseline " + path + ": " + e.what());
+        }
+
+        map<string, double> means;
+        for (auto &entry : report.results) {
+            means[entry.first] = entry.second.mean_us;
+        }
+        return means;
+    }
+
+    string quoted(const string &value) {
+        return "\"" + value + "\"";
+    }
+
+    void write_json(ostream &out, const BenchConfig &config, const map<string, OpStats> &stats,
+                    const StatsReport &phases, const map<string, double> &baseline, bool &regressed) {
+        BenchReport report;
+        report.config = {
+            {"engine", quoted(config.engine)}, {"scheme", quoted(config.scheme)},
+            {"degree", to_string(config.degree)}, {"radix", to_string(config.radix)},
+            {"cache_size", to_string(config.cache_size)}, {"min", to_string(config.min_val)},
+            {"max", to_string(config.max_val)}, {"values", to_string(config.nb_values)},
+            {"threads", to_string(ThreadPool::global().size() + 1)}, {"reps", to_string(config.reps)},
+            {"seed", to_string(config.seed)}, {"pool", quoted(config.pool)},
+            {"huge_pages", quoted(config.pages)}, {"memo", to_string(config.memo)}
+        };
+        report.results = stats;
+
+        // where encrypt spent its time, Rache and Inche only
+        if (Stats::enabled()) {
+            report.phases = phases;
+        }
+
+        regressed = false;
+        report.compared = !baseline.empty();
+        for (auto &entry : stats) {
+            auto found = baseline.find(entry.first);
+            if (found == baseline.end() || found->second <= 0) {
+                continue;
+            }
+
+            auto &op = report.comparison[entry.first];
+            op.baseline_mean_us = found->second;
+            op.change = entry.second.mean_us / found->second - 1;
+            op.regressed = op.change > config.threshold;
+            regressed |= op.regressed;
+        }
+        write_bench_report(out, report);
+    }
+} // namespace
+
+int bench_cli(int argc, char **argv) {
+    BenchConfig config;
+    map<string, double> baseline;
+    try {
+        config = parse_args(argc, argv);
+        if (!config.baseline.empty()) {
+            baseline = read_baseline(config.baseline);
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl << USAGE << endl;
+        return 1;
+    }
+
+    // before anything touches the pool
+    ThreadPool::set_global_size(config.threads);
+
+    mt19937_64 gen(config.seed);
+    uniform_int_distribution<uint64_t> dist(config.min_val, config.max_val);
+    vector<double> values(config.nb_values);
+    for (auto &value : values) {
+        value = dist(gen);
+    }
+
+    map<string, Samples> samples;
+    StatsReport phases;
+    try {
+        auto params = make_params(config);
+        auto &setup = samples["setup"];
+        if (config.engine == "rache") {
+            unique_ptr<Rache> rache;
+            setup.push_back(time_us([&] { rache.reset(new Rache(params, config.cache_size, config.radix)); }));
+            if (config.pool == "thread") {
+                rache->use_thread_local_pools();
+            }
+            rache->set_seed(config.seed);
+            rache->set_memo(config.memo);
+            run_engine(*rache, config, values, samples, *rache->key_context());
+            phases = rache->stats();
+        } else if (config.engine == "inche") {
+            unique_ptr<Inche> inche;
+            setup.push_back(time_us([&] { inche.reset(new Inche(make_shared<const KeyContext>(params))); }));
+            if (config.pool == "thread") {
+                inche->use_thread_local_pools();
+            }
+            inche->set_huge_pages(parse_huge_pages(config.pages));
+            run_engine(*inche, config, values, samples, *inche->key_context());
+            phases = inche->stats();
+        } else {
+            shared_ptr<const KeyContext> keys;
+            unique_ptr<SealEngine> engine;
+            setup.push_back(time_us([&] {
+                keys = make_shared<const KeyContext>(params);
+                engine.reset(new SealEngine(keys));
+            }));
+            run_engine(*engine, config, values, samples, *keys);
+        }
+    } catch (const exception &e) {
+        cerr << "Benchmark failed: " << e.what() << endl;
+        return 1;
+    }
+
+    map<string, OpStats> stats;
+    for (auto &entry : samples) {
+        // e.g. no additions with a single value
+        if (!entry.second.empty()) {
+            stats[entry.first] = summarize(entry.second);
+        }
+    }
+
+    bool regressed;
+    if (config.output.empty()) {
+        write_json(cout, config, stats, phases, baseline, regressed);
+    } else {
+        ofstream out(config.output);
+        if (!out.is_open()) {
+            cerr << "Failed to open file: " << config.output << endl;
+            return 1;
+        }
+        write_json(out, config, stats, phases, baseline, regressed);
+    }
+
+    if (regressed) {
+        cerr << "Regressed by more than " << config.threshold * 100 << "% against " << config.baseline << endl;
+        return 3;
+    }
+    return 0;
+}
@@ -147,13 +147,12 @@ void ckks_bench() {
     cout << "Initialization of Rache took " << duration.count() << " microseconds." << endl;
     
     // Store ciphertexts to check output later
-    Ciphertext ctxt[SIZE];
+    vector<Ciphertext> ctxt;
+    vector<double> values(random_arr, random_arr + SIZE);
 
     cout << "Encrypting random array with Rache..." << endl;
     start = chrono::high_resolution_clock::now();
-    for (int i = 0; i < SIZE; i ++) {
-        rache.encrypt(random_arr[i], ctxt[i]);
-    }
+    rache.encrypt_batch(values, ctxt);
     stop = chrono::high_resolution_clock::now();
     duration = chrono::duration_cast<chrono::microseconds>(stop - start);
     cout << "Encryption of " << SIZE << " numbers in Rache took " << duration.count() << " microseconds ("
@@ -1,118 +1,206 @@
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <stdexcept>
 #include "inche.h"
 #include "racheal.h"
+#include "loader.h"
+#include "columnfile.h"
 
 using namespace inche;
 using namespace racheal;
 
+// number of values handed to the batch encryption APIs at a time
+const size_t BATCH_SIZE = 64;
+
+// runs encrypt_chunk on every chunk of the dataset, timing only the encryption
+template <typename EncryptChunk>
+std::chrono::nanoseconds stream_dataset(che_utils::DatasetReader &reader, EncryptChunk encrypt_chunk) {
+    std::chrono::nanoseconds elapsed(0);
+    std::vector<double> vals;
+    while (reader.next(vals)) {
+        auto start = std::chrono::high_resolution_clock::now();
+        encrypt_chunk(vals);
+        auto stop = std::chrono::high_resolution_clock::now();
+        elapsed += stop - start;
+    }
+    return elapsed;
+}
+
 void datasets() {
     // Define the file name
     std::string filename;
     std::cout << "Enter file name: ";
     std::cin >> filename;
-    std::ifstream infile(filename);
-    
-    // Check if the file was opened successfully
-    if (!infile.is_open()) {
-        std::cerr << "Failed to open file: " << filename << std::endl;
-    }
 
-    std::cout << "Reading file... ";
-    
-    // Read the file line by line
-    std::string line;
-    std::vector<double> vals;
-    while (std::getline(infile, line)) {
-        vals.push_back(std::stod(line));
+    // the file is mapped rather than read, values are parsed chunk by chunk as they are encrypted
+    std::unique_ptr<che_utils::DatasetReader> reader;
+    try {
+        reader.reset(new che_utils::DatasetReader(filename));
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return;
     }
-    
-    infile.close();
+    std::cout << "Size of dataset: " << reader->file_size() << " bytes." << std::endl;
 
-    std::cout << "Done." << std::endl;
-    auto size = vals.size();
-    std::cout << "Size of dataset: " << size << " objects." << std::endl;
-
-    std::cout << "Choose scheme: [1] CKKS; [2] RacheCKKS; [3] Zinc: ";
+    std::cout << "Choose scheme: [1] CKKS; [2] RacheCKKS; [3] Zinc; [4] RacheCKKS (balanced digits); [5] RacheBFV (packed integers): ";
     int scheme;
     std::cin >> scheme;
 
+    std::string output;
+    std::cout << "Save ciphertexts to (- to discard): ";
+    std::cin >> output;
+
+    // rows are serialized on the writer's own thread while encryption carries on
+    std::unique_ptr<che_utils::ColumnWriter> writer;
+    if (output != "-") {
+        try {
+            writer.reset(new che_utils::ColumnWriter(output));
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return;
+        }
+    }
+    // copied, not moved: every case encrypts into the same ciphertexts again, and a
+    // moved-from Ciphertext has no memory pool left to do that with
+    auto keep = [&](const seal::Ciphertext &ctxt) {
+        if (writer) {
+            writer->append(ctxt);
+        }
+    };
+
     // Test setup
     std::cout << "Setting up encryption objects... ";
     seal::Ciphertext ctxt;
-    std::chrono::seconds duration;
-    switch (scheme)
-    {
-    case 1:
-    {
-        seal::EncryptionParameters params(seal::scheme_type::ckks);
-        params.set_poly_modulus_degree(32768);
-    
-        // choose 60 bit primes for first and last (last should just be at least as large as first)
-        // also choose intermediate primes to be close to each other
-        auto coeffs = seal::CoeffModulus::BFVDefault(32768);
-        params.set_coeff_modulus(coeffs);
-    
-        // scale stabilization close to the intermediate primes
-        double scale = pow(2.0, log2(*(coeffs[2].data())));
-    
-        // context gathers params
-        seal::SEALContext context(params);
+    std::chrono::nanoseconds duration(0);
+    // a value the chosen scheme can't encrypt stops the run instead of being altered
+    try {
+        switch (scheme)
+        {
+        case 1:
+        {
+            seal::EncryptionParameters params(seal::scheme_type::ckks);
+            params.set_poly_modulus_degree(32768);
         
-        // generate keys
-        seal::KeyGenerator keygen(context);
-        seal::SecretKey secret_key = keygen.secret_key();
-        seal::PublicKey public_key;
-        keygen.create_public_key(public_key);
-
-        // encryptor
-        seal::Encryptor encryptor(context, public_key);
-        // encoder for ckks scheme
-        seal::CKKSEncoder encoder(context);
-
-        std::cout << "Running data... " << std::endl;
-        seal::Plaintext plain;
-        auto start = std::chrono::high_resolution_clock::now();
-        for (int i = 0; i < size; i++) {
-            encoder.encode(vals[i], plain);
-            encryptor.encrypt(plain, ctxt);
+            // choose 60 bit primes for first and last (last should just be at least as large as first)
+            // also choose intermediate primes to be close to each other
+            auto coeffs = seal::CoeffModulus::BFVDefault(32768);
+            params.set_coeff_modulus(coeffs);
+        
+            // scale stabilization close to the intermediate primes
+            double scale = pow(2.0, log2(*(coeffs[2].data())));
+        
+            // context gathers params
+            seal::SEALContext context(params);
+            
+            // generate keys
+            seal::KeyGenerator keygen(context);
+            seal::SecretKey secret_key = keygen.secret_key();
+            seal::PublicKey public_key;
+            keygen.create_public_key(public_key);
+
+            // encryptor
+            seal::Encryptor encryptor(context, public_key);
+            // encoder for ckks scheme
+            seal::CKKSEncoder encoder(context);
+
+            std::cout << "Running data... " << std::endl;
+            seal::Plaintext plain;
+            duration = stream_dataset(*reader, [&](const std::vector<double> &vals) {
+                for (double val : vals) {
+                    encoder.encode(val, plain);
+                    encryptor.encrypt(plain, ctxt);
+                    keep(ctxt);
+                }
+            });
+            break;
         }
-        auto stop = std::chrono::high_resolution_clock::now();
-        duration = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
-        break;
-    }
-    case 2:
-    {
-        Rache rache(seal::scheme_type::ckks, 33, 2);
+        case 2: case 4:
+        {
+            Rache rache(seal::scheme_type::ckks, 33, 2);
+            if (scheme == 4) {
+                rache.set_digit_mode(digit_mode::balanced);
+            }
 
-        std::cout << "Running data... " << std::endl;
-        auto start = std::chrono::high_resolution_clock::now();
-        for (int i = 0; i < size; i++) {
-            rache.encrypt(vals[i], ctxt);
+            std::cout << "Running data... " << std::endl;
+            // ciphertexts are several MB each, so encrypt in blocks and reuse them
+            std::vector<double> batch;
+            std::vector<seal::Ciphertext> ctxts;
+            duration = stream_dataset(*reader, [&](const std::vector<double> &vals) {
+                for (size_t i = 0; i < vals.size(); i += BATCH_SIZE) {
+                    batch.assign(vals.begin() + i, vals.begin() + std::min(vals.size(), i + BATCH_SIZE));
+                    rache.encrypt_batch(batch, ctxts);
+                    for (auto &ctxt : ctxts) {
+                        keep(ctxt);
+                    }
+                }
+            });
+            break;
         }
-        auto stop = std::chrono::high_resolution_clock::now();
-        duration = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
-        break;
-    }
-    case 3:
-    {
-        Inche inche(seal::scheme_type::ckks);
+        case 3:
+        {
+            Inche inche(seal::scheme_type::ckks);
 
-        std::cout << "Running data... " << std::endl;
-        auto start = std::chrono::high_resolution_clock::now();
-        for (int i = 0; i < size; i++) {
-            inche.encrypt(vals[i], ctxt);
+            std::cout << "Running data... " << std::endl;
+            duration = stream_dataset(*reader, [&](const std::vector<double> &vals) {
+                for (double val : vals) {
+                    inche.encrypt(val, ctxt);
+                    keep(ctxt);
+                }
+            });
+            break;
         }
-        auto stop = std::chrono::high_resolution_clock::now();
-        duration = std::chrono::duration_cast<std::chrono::seconds>(stop - start);
-        break;
+        case 5:
+        {
+            // whole numbers only, one ciphertext holds N of them
+            Rache rache(seal::scheme_type::bfv, 29, 2);
+            size_t slots = rache.slot_count();
+
+            std::cout << "Running data... " << std::endl;
+            // chunks don't line up with ciphertexts, so values carry over to the next chunk
+            std::vector<uint64_t> packed;
+            duration = stream_dataset(*reader, [&](const std::vector<double> &vals) {
+                for (double val : vals) {
+                    // rather than truncate or clamp, so this run encrypts the same data as the others
+                    if (val < 0 || val != std::trunc(val)) {
+                        throw std::invalid_argument("RacheBFV only packs non-negative integers, the dataset has "
+                                                    + std::to_string(val));
+                    }
+                    packed.push_back(static_cast<uint64_t>(val));
+                    if (packed.size() == slots) {
+                        rache.encrypt(packed, ctxt);
+                        keep(ctxt);
+                        packed.clear();
+                    }
+                }
+            });
+            if (!packed.empty()) {
+                auto start = std::chrono::high_resolution_clock::now();
+                rache.encrypt(packed, ctxt);
+                keep(ctxt);
+                duration += std::chrono::high_resolution_clock::now() - start;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    } catch (const std::invalid_argument &e) {
+        std::cerr << std::endl << "Stopped after " << reader->values_read() << " values: " << e.what() << std::endl;
+        return;
     }
-    default:
-        break;
+
+    // whatever the writer hasn't caught up with yet counts too
+    if (writer) {
+        auto start = std::chrono::high_resolution_clock::now();
+        writer->close();
+        duration += std::chrono::high_resolution_clock::now() - start;
     }
 
     std::cout << "Done." << std::endl;
-    std::cout << "Took " << duration.count() << " seconds." << std::endl;
+    std::cout << "Encrypted " << reader->values_read() << " objects in " 
+              << std::chrono::duration_cast<std::chrono::seconds>(duration).count() << " seconds." << std::endl;
 }
\ No newline at end of file
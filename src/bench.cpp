@@ -2,7 +2,12 @@
 
 using namespace std;
 
-int main() {
+int main(int argc, char **argv) {
+    // any arguments at all skip the menu
+    if (argc > 1) {
+        return bench_cli(argc, argv);
+    }
+
     int selection = 0;
 
     do {
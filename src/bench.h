@@ -13,9 +13,12 @@ void cipher_stream();
 
 void datasets();
 
-// initializes an array with random values
-inline void initialize(int arr[], int size, int MIN_VAL, int MAX_VAL, bool PRINT) {
-    srand(time(0));
+// runs the benchmarks described by the command line and prints JSON, see BenchRunner.cpp
+int bench_cli(int argc, char **argv);
+
+// initializes an array with random values, pass a seed to get the same array every run
+inline void initialize(int arr[], int size, int MIN_VAL, int MAX_VAL, bool PRINT, unsigned seed = time(0)) {
+    srand(seed);
 
     for(int i = 0; i < size; i++) {
         if(MIN_VAL == MAX_VAL) {
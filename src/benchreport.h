@@ -0,0 +1,357 @@
+#ifndef BENCHREPORT_H
+#define BENCHREPORT_H
+
+#include <stddef.h>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "stats.h"
+
+namespace che_utils {
+    /**
+     * Latency and throughput of one benchmarked operation.
+     */
+    struct OpStats {
+        double mean_us = 0;
+        double p50_us = 0;
+        double p99_us = 0;
+        double throughput = 0;
+    };
+
+    /**
+     * How one operation did against a baseline run.
+     */
+    struct OpComparison {
+        double baseline_mean_us = 0;
+        double change = 0;
+        bool regressed = false;
+    };
+
+    /**
+     * The JSON document the benchmark runner writes for one run, and reads back
+     * from a baseline file.
+     */
+    struct BenchReport {
+        // the run's settings in order, values already rendered as JSON strings or numbers
+        std::vector<std::pair<std::string, std::string>> config;
+        std::map<std::string, OpStats> results;
+
+        // where encrypt spent its time, empty if nothing was recorded
+        StatsReport phases;
+
+        // whether the run was compared against a baseline, even if no operation matched
+        bool compared = false;
+        std::map<std::string, OpComparison> comparison;
+    };
+
+    /**
+     * @brief Writes report as JSON, the only format read_bench_report accepts.
+     */
+    inline void write_bench_report(std::ostream &out, const BenchReport &report) {
+        out << "{" << std::endl;
+        out << "  \"config\": {";
+        for (size_t i = 0; i < report.config.size(); i++) {
+            out << (i == 0 ? "" : ", ") << "\"" << report.config[i].first << "\": " << report.config[i].second;
+        }
+        out << "}," << std::endl;
+
+        out << "  \"results\": {" << std::endl;
+        size_t i = 0;
+        for (auto &entry : report.results) {
+            auto &op = entry.second;
+            out << "    \"" << entry.first << "\": {\"mean_us\": " << op.mean_us << ", \"p50_us\": " << op.p50_us
+                << ", \"p99_us\": " << op.p99_us << ", \"throughput\": " << op.throughput << "}"
+                << (++i < report.results.size() ? "," : "") << std::endl;
+        }
+        out << "  }";
+
+        if (!report.phases.phases.empty()) {
+            out << "," << std::endl << "  \"phases\": ";
+            report.phases.dump(out);
+        }
+
+        if (report.compared) {
+            out << "," << std::endl << "  \"comparison\": {" << std::endl;
+            i = 0;
+            for (auto &entry : report.comparison) {
+                auto &op = entry.second;
+                out << "    \"" << entry.first << "\": {\"baseline_mean_us\": " << op.baseline_mean_us
+                    << ", \"change\": " << op.change << ", \"regressed\": " << (op.regressed ? "true" : "false") << "}"
+                    << (++i < report.comparison.size() ? "," : "") << std::endl;
+            }
+            out << "  }";
+        }
+        out << std::endl << "}" << std::endl;
+    }
+
+    namespace detail {
+        // a recursive descent over exactly the layout write_bench_report produces,
+        // any other key, type or order is an error
+        class BenchReportParser {
+        public:
+            explicit BenchReportParser(const std::string &text) : text(text), pos(0) {}
+
+            BenchReport parse() {
+                BenchReport report;
+                expect('{');
+                key("config");
+                parse_config(report);
+                expect(',');
+                key("results");
+                parse_results(report);
+
+                if (consume(',')) {
+                    std::string name = string();
+                    if (name == "phases") {
+                        expect(':');
+                        parse_phases(report);
+                        if (consume(',')) {
+                            key("comparison");
+                            parse_comparison(report);
+                        }
+                    } else if (name == "comparison") {
+                        expect(':');
+                        parse_comparison(report);
+                    } else {
+                        fail("unexpected key \"" + name + "\"");
+                    }
+                }
+                expect('}');
+
+                skip_space();
+                if (pos != text.size()) {
+                    fail("trailing content");
+                }
+                return report;
+            }
+
+        private:
+            void parse_config(BenchReport &report) {
+                expect('{');
+                if (consume('}')) {
+                    return;
+                }
+                do {
+                    std::string name = string();
+                    expect(':');
+                    skip_space();
+                    std::string value;
+                    if (pos < text.size() && text[pos] == '"') {
+                        value = "\"" + string() + "\"";
+                    } else {
+                        size_t start = pos;
+                        number();
+                        value = text.substr(start, pos - start);
+                    }
+                    report.config.emplace_back(name, value);
+                } while (consume(','));
+                expect('}');
+            }
+
+            void parse_results(BenchReport &report) {
+                expect('{');
+                if (consume('}')) {
+                    return;
+                }
+                do {
+                    std::string name = string();
+                    expect(':');
+                    OpStats op;
+                    expect('{');
+                    key("mean_us");
+                    op.mean_us = number();
+                    expect(',');
+                    key("p50_us");
+                    op.p50_us = number();
+                    expect(',');
+                    key("p99_us");
+                    op.p99_us = number();
+                    expect(',');
+                    key("throughput");
+                    op.throughput = number();
+                    expect('}');
+                    if (!report.results.emplace(name, op).second) {
+                        fail("duplicate result \"" + name + "\"");
+                    }
+                } while (consume(','));
+                expect('}');
+            }
+
+            void parse_phases(BenchReport &report) {
+                expect('{');
+                if (consume('}')) {
+                    return;
+                }
+                do {
+                    PhaseReport phase;
+                    phase.name = string();
+                    expect(':');
+                    expect('{');
+                    key("calls");
+                    phase.calls = integer();
+                    expect(',');
+                    key("total_ns");
+                    phase.total_ns = integer();
+
+                    // derived from the histogram, so only checked for being numbers
+                    for (const char *derived : {"mean_ns", "p50_ns", "p99_ns"}) {
+                        expect(',');
+                        key(derived);
+                        number();
+                    }
+                    expect(',');
+                    key("histogram");
+                    expect('[');
+                    if (!consume(']')) {
+                        size_t b = 0;
+                        do {
+                            if (b == PhaseReport::NB_BUCKETS) {
+                                fail("too many histogram buckets");
+                            }
+                            phase.histogram[b++] = integer();
+                        } while (consume(','));
+                        expect(']');
+                    }
+                    expect('}');
+                    report.phases.phases.push_back(phase);
+                } while (consume(','));
+                expect('}');
+            }
+
+            void parse_comparison(BenchReport &report) {
+                report.compared = true;
+                expect('{');
+                if (consume('}')) {
+                    return;
+                }
+                do {
+                    std::string name = string();
+                    expect(':');
+                    OpComparison op;
+                    expect('{');
+                    key("baseline_mean_us");
+                    op.baseline_mean_us = number();
+                    expect(',');
+                    key("change");
+                    op.change = number();
+                    expect(',');
+                    key("regressed");
+                    op.regressed = boolean();
+                    expect('}');
+                    if (!report.comparison.emplace(name, op).second) {
+                        fail("duplicate comparison \"" + name + "\"");
+                    }
+                } while (consume(','));
+                expect('}');
+            }
+
+            void skip_space() {
+                while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+                    pos++;
+                }
+            }
+
+            bool consume(char c) {
+                skip_space();
+                if (pos < text.size() && text[pos] == c) {
+                    pos++;
+                    return true;
+                }
+                return false;
+            }
+
+            void expect(char c) {
+                if (!consume(c)) {
+                    fail(std::string("expected '") + c + "'");
+                }
+            }
+
+            void key(const std::string &name) {
+                if (string() != name) {
+                    fail("expected key \"" + name + "\"");
+                }
+                expect(':');
+            }
+
+            // names and settings never need escaping, so a backslash is an error too
+            std::string string() {
+                expect('"');
+                size_t end = text.find_first_of("\"\\", pos);
+                if (end == std::string::npos || text[end] != '"') {
+                    fail("unterminated or escaped string");
+                }
+                std::string value = text.substr(pos, end - pos);
+                pos = end + 1;
+                return value;
+            }
+
+            double number() {
+                skip_space();
+                size_t end = pos;
+                while (end < text.size() && (std::isdigit(static_cast<unsigned char>(text[end]))
+                        || text[end] == '-' || text[end] == '+' || text[end] == '.' || text[end] == 'e')) {
+                    end++;
+                }
+                std::string token = text.substr(pos, end - pos);
+                char *parsed = nullptr;
+                double value = token.empty() ? 0 : std::strtod(token.c_str(), &parsed);
+                if (token.empty() || parsed != token.c_str() + token.size()) {
+                    fail("expected a number");
+                }
+                pos = end;
+                return value;
+            }
+
+            std::uint64_t integer() {
+                skip_space();
+                size_t end = pos;
+                while (end < text.size() && std::isdigit(static_cast<unsigned char>(text[end]))) {
+                    end++;
+                }
+                if (end == pos) {
+                    fail("expected an integer");
+                }
+                std::uint64_t value = std::strtoull(text.substr(pos, end - pos).c_str(), nullptr, 10);
+                pos = end;
+                return value;
+            }
+
+            bool boolean() {
+                skip_space();
+                for (bool value : {true, false}) {
+                    std::string word = value ? "true" : "false";
+                    if (text.compare(pos, word.size(), word) == 0) {
+                        pos += word.size();
+                        return value;
+                    }
+                }
+                fail("expected true or false");
+                return false;
+            }
+
+            [[noreturn]] void fail(const std::string &what) const {
+                throw std::invalid_argument("Malformed benchmark report at byte " + std::to_string(pos) + ": " + what);
+            }
+
+            const std::string &text;
+            size_t pos;
+        };
+    } // namespace detail
+
+    /**
+     * @brief Parses a report written by write_bench_report.
+     *
+     * @throws std::invalid_argument if text is anything but such a report
+     */
+    inline BenchReport read_bench_report(const std::string &text) {
+        return detail::BenchReportParser(text).parse();
+    }
+} // namespace che_utils
+
+#endif
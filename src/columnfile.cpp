@@ -0,0 +1,203 @@
+#include "columnfile.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace seal;
+
+namespace che_utils {
+    namespace {
+        struct ColumnHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t compr_mode;
+        };
+
+        // at the very end, so the index can be found without scanning the rows
+        struct ColumnTrailer {
+            uint64_t index_offset;
+            uint64_t nb_rows;
+            char magic[8];
+        };
+
+        const char COLUMN_MAGIC[8] = "CHECOLS";
+
+        // bump whenever the layout changes
+        const uint32_t COLUMN_VERSION = 1;
+    } // namespace
+
+    ColumnWriter::ColumnWriter(const std::string &path, compr_mode_type compr_mode, size_t batch_rows)
+        : out(path, std::ios::binary | std::ios::trunc), path(path), compr_mode(compr_mode),
+          batch_rows(std::max<size_t>(1, batch_rows)) {
+        if (!Serialization::IsSupportedComprMode(compr_mode)) {
+            throw std::invalid_argument("Compression mode not supported by this SEAL build");
+        }
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        ColumnHeader header = {};
+        std::memcpy(header.magic, COLUMN_MAGIC, sizeof(header.magic));
+        header.version = COLUMN_VERSION;
+        header.compr_mode = static_cast<uint32_t>(compr_mode);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        offsets.push_back(sizeof(header));
+
+        filling.reserve(this->batch_rows);
+        draining.reserve(this->batch_rows);
+        writer = std::thread([this] { writer_loop(); });
+    }
+
+    ColumnWriter::~ColumnWriter() {
+        try {
+            close();
+        } catch (...) {
+            // nowhere to report it from a destructor
+        }
+    }
+
+    void ColumnWriter::append(Ciphertext ctxt) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (closing) {
+            throw std::logic_error("Cannot append to a closed column file");
+        }
+        check_error_locked();
+
+        filling.push_back(std::move(ctxt));
+        appended++;
+        if (filling.size() < batch_rows) {
+            return;
+        }
+
+        // hand the batch over once the writer is done with the previous one
+        changed.wait(guard, [this] { return draining.empty() || error; });
+        check_error_locked();
+        std::swap(filling, draining);
+        changed.notify_all();
+    }
+
+    void ColumnWriter::close() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (closed) {
+                return;
+            }
+
+            // the last, partial batch goes out too
+            changed.wait(guard, [this] { return draining.empty() || error; });
+            std::swap(filling, draining);
+            closing = true;
+            closed = true;
+            changed.notify_all();
+        }
+        writer.join();
+
+        std::lock_guard<std::mutex> guard(lock);
+        check_error_locked();
+
+        ColumnTrailer trailer = {};
+        trailer.index_offset = offsets.back();
+        trailer.nb_rows = offsets.size() - 1;
+        std::memcpy(trailer.magic, COLUMN_MAGIC, sizeof(trailer.magic));
+        out.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write file: " + path);
+        }
+    }
+
+    void ColumnWriter::check_error_locked() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void ColumnWriter::writer_loop() {
+        std::vector<seal_byte> buffer;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [this] { return !draining.empty() || closing; });
+                if (draining.empty()) {
+                    return;
+                }
+            }
+
+            // draining is ours until it is cleared, append only swaps an empty one
+            try {
+                for (auto &ctxt : draining) {
+                    buffer.resize(ctxt.save_size(compr_mode));
+                    size_t size = ctxt.save(buffer.data(), buffer.size(), compr_mode);
+                    out.write(reinterpret_cast<const char *>(buffer.data()), size);
+                    offsets.push_back(offsets.back() + size);
+                }
+                if (!out) {
+                    throw std::runtime_error("Failed to write file: " + path);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(lock);
+                error = std::current_exception();
+                changed.notify_all();
+                return;
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            draining.clear();
+            changed.notify_all();
+        }
+    }
+
+    ColumnReader::ColumnReader(const std::string &path, std::shared_ptr<const SEALContext> context)
+        : file(path), context(context) {
+        ColumnHeader header;
+        ColumnTrailer trailer;
+        if (file.size() < sizeof(header) + sizeof(trailer)) {
+            throw std::invalid_argument("Not a column file: " + path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        std::memcpy(&trailer, file.data() + file.size() - sizeof(trailer), sizeof(trailer));
+        if (std::memcmp(header.magic, COLUMN_MAGIC, sizeof(header.magic)) != 0) {
+            throw std::invalid_argument("Not a column file: " + path);
+        }
+        if (header.version != COLUMN_VERSION) {
+            throw std::invalid_argument(
+                "Unsupported column file version " + std::to_string(header.version) + 
+                    ", expected: " + std::to_string(COLUMN_VERSION)
+            );
+        }
+
+        // a writer that never got to close leaves no trailer behind, the row count is
+        // bounded first so the index size can't overflow
+        size_t body_size = file.size() - sizeof(trailer);
+        if (std::memcmp(trailer.magic, COLUMN_MAGIC, sizeof(trailer.magic)) != 0 
+                || trailer.nb_rows >= body_size / sizeof(uint64_t)
+                || trailer.index_offset != body_size - (trailer.nb_rows + 1) * sizeof(uint64_t)) {
+            throw std::invalid_argument("Unfinished or truncated column file: " + path);
+        }
+
+        size_t index_bytes = (trailer.nb_rows + 1) * sizeof(uint64_t);
+        offsets.resize(trailer.nb_rows + 1);
+        std::memcpy(offsets.data(), file.data() + trailer.index_offset, index_bytes);
+
+        // rows lie back to back between the header and the index, read() relies on it
+        if (offsets.front() < sizeof(header) || offsets.back() > trailer.index_offset) {
+            throw std::invalid_argument("Corrupt row index in column file: " + path);
+        }
+        for (size_t i = 1; i < offsets.size(); i++) {
+            if (offsets[i] < offsets[i - 1]) {
+                throw std::invalid_argument("Corrupt row index in column file: " + path);
+            }
+        }
+    }
+
+    void ColumnReader::read(size_t row, Ciphertext &destination) const {
+        if (row >= rows()) {
+            throw std::out_of_range(
+                "Row " + std::to_string(row) + " out of range, the file has " + std::to_string(rows())
+            );
+        }
+
+        auto in = reinterpret_cast<const seal_byte *>(file.data());
+        destination.load(*context, in + offsets[row], offsets[row + 1] - offsets[row]);
+    }
+} // namespace che_utils
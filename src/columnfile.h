@@ -0,0 +1,138 @@
+#ifndef COLUMNFILE_H
+#define COLUMNFILE_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "seal/seal.h"
+#include "mappedfile.h"
+
+namespace che_utils {
+    /**
+     * Appends ciphertexts, one row each, to a column file:
+     *
+     *     header | row 0 | row 1 | ... | row offsets (rows + 1) | trailer
+     *
+     * Every row is a SEAL ciphertext compressed on its own, so any row can be read
+     * back without touching the others. Serialization, compression and I/O happen
+     * on a dedicated writer thread: append fills one batch while the writer drains
+     * the other, and only blocks when both are full, so at most two batches of
+     * ciphertexts are held in memory.
+     */
+    class ColumnWriter {
+    public:
+        /**
+         * @brief Creates (or truncates) the file at path and starts the writer thread.
+         *
+         * @param path the file to write
+         * @param compr_mode how each row is compressed
+         * @param batch_rows ciphertexts handed to the writer at a time
+         * @throws std::invalid_argument if the compression mode is not available
+         * @throws std::runtime_error if the file cannot be opened
+         */
+        explicit ColumnWriter(const std::string &path, 
+                              seal::compr_mode_type compr_mode = seal::Serialization::compr_mode_default,
+                              size_t batch_rows = 8);
+
+        /**
+         * @brief Closes the file if close hasn't been called, dropping any write error.
+         */
+        ~ColumnWriter();
+
+        ColumnWriter(const ColumnWriter &) = delete;
+        ColumnWriter &operator=(const ColumnWriter &) = delete;
+
+        /**
+         * @brief Queues a ciphertext as the next row. Moving it in avoids a copy.
+         *
+         * @throws std::runtime_error if an earlier row could not be written
+         */
+        void append(seal::Ciphertext ctxt);
+
+        /**
+         * @brief Writes out every queued row and the row index, then stops the writer.
+         *        Nothing may be appended afterwards.
+         *
+         * @throws std::runtime_error if a row or the index could not be written
+         */
+        void close();
+
+        /**
+         * @brief Number of rows appended so far.
+         */
+        size_t rows() const {
+            return appended;
+        }
+
+    private:
+        void writer_loop();
+
+        // throws the writer thread's error, if it had one (lock must be held)
+        void check_error_locked();
+
+        std::ofstream out;
+        std::string path;
+        seal::compr_mode_type compr_mode;
+        size_t batch_rows;
+        size_t appended = 0;
+
+        // filled by append, drained by the writer, swapped when both are ready
+        std::vector<seal::Ciphertext> filling;
+        std::vector<seal::Ciphertext> draining;
+
+        // only touched by the writer until it has stopped
+        std::vector<std::uint64_t> offsets;
+
+        std::mutex lock;
+        std::condition_variable changed;
+        bool closing = false;
+        bool closed = false;
+        std::exception_ptr error;
+        std::thread writer;
+    };
+
+    /**
+     * Random access to the rows of a file written by ColumnWriter. The file is
+     * memory-mapped, reading a row only touches the pages that row is stored in.
+     */
+    class ColumnReader {
+    public:
+        /**
+         * @brief Maps a column file and reads its row index.
+         *
+         * @param path the file to read
+         * @param context the context the ciphertexts were encrypted under
+         * @throws std::invalid_argument if the file is not a (complete) column file
+         */
+        ColumnReader(const std::string &path, std::shared_ptr<const seal::SEALContext> context);
+
+        /**
+         * @brief Number of rows in the file.
+         */
+        size_t rows() const {
+            return offsets.size() - 1;
+        }
+
+        /**
+         * @brief Loads one row, safe to call from several threads at once.
+         *
+         * @param row the row to load
+         * @param destination the ciphertext to overwrite with it
+         * @throws std::out_of_range if there is no such row
+         */
+        void read(size_t row, seal::Ciphertext &destination) const;
+
+    private:
+        MappedFile file;
+        std::shared_ptr<const seal::SEALContext> context;
+        std::vector<std::uint64_t> offsets;
+    };
+} // namespace che_utils
+
+#endif
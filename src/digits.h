@@ -0,0 +1,206 @@
+#ifndef DIGITS_H
+#define DIGITS_H
+
+#include <stddef.h>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace che_utils {
+    namespace detail {
+        // a radix known at compile time, / and % by it compile to shifts and masks for
+        // powers of two and to a multiplication by the reciprocal for the others
+        template <std::uint32_t Radix>
+        struct ConstRadix {
+            static_assert(Radix >= 2, "Radix must be at least 2");
+
+            std::uint32_t value() const {
+                return Radix;
+            }
+
+            std::uint64_t div(std::uint64_t v) const {
+                return v / Radix;
+            }
+
+            std::uint32_t mod(std::uint64_t v) const {
+                return v % Radix;
+            }
+        };
+
+        // any other power of two, by a shift and mask chosen at runtime
+        struct ShiftRadix {
+            std::uint32_t radix;
+            unsigned shift;
+
+            std::uint32_t value() const {
+                return radix;
+            }
+
+            std::uint64_t div(std::uint64_t v) const {
+                return v >> shift;
+            }
+
+            std::uint32_t mod(std::uint64_t v) const {
+                return v & (radix - 1);
+            }
+        };
+
+        // the fallback, a hardware division per digit
+        struct RuntimeRadix {
+            std::uint32_t radix;
+
+            std::uint32_t value() const {
+                return radix;
+            }
+
+            std::uint64_t div(std::uint64_t v) const {
+                return v / radix;
+            }
+
+            std::uint32_t mod(std::uint64_t v) const {
+                return v % radix;
+            }
+        };
+
+        template <class Radix>
+        void split_digits(const Radix &radix, std::uint64_t v, std::vector<std::int32_t> &digits) {
+            digits.clear();
+            while (v > 0) {
+                digits.push_back(radix.mod(v));
+                v = radix.div(v);
+            }
+        }
+
+        template <class Radix>
+        void split_balanced_digits(const Radix &radix, std::uint64_t v, std::vector<std::int32_t> &digits) {
+            digits.clear();
+            std::int32_t r = radix.value();
+            while (v > 0) {
+                std::int32_t d;
+                if (r == 2) {
+                    // non-adjacent form, an odd v picks whichever of +-1 leaves v/2 even
+                    d = (v & 1) ? 2 - static_cast<std::int32_t>(v & 3) : 0;
+                } else {
+                    d = radix.mod(v);
+                    if (d > r / 2) {
+                        d -= r;
+                    }
+                }
+
+                digits.push_back(d);
+                v = radix.div(d < 0 ? v + static_cast<std::uint64_t>(-d) : v - d);
+            }
+        }
+    } // namespace detail
+
+    /**
+     * Splits unsigned integers into their digits in a fixed radix with integer
+     * arithmetic only. The common radices get kernels specialized at compile time,
+     * other powers of two shift and mask, and anything else divides at runtime.
+     */
+    class DigitSplitter {
+    public:
+        /**
+         * @param radix the radix, at least 2
+         * @throws std::invalid_argument if the radix is smaller than 2
+         */
+        explicit DigitSplitter(std::uint32_t radix = 2) : radix(radix) {
+            if (radix < 2) {
+                throw std::invalid_argument("Radix must be at least 2, got: " + std::to_string(radix));
+            }
+
+            shift = 0;
+            if ((radix & (radix - 1)) == 0) {
+                while ((std::uint32_t(1) << shift) != radix) {
+                    shift++;
+                }
+            }
+
+            // r^k for as long as it fits, the last entry is the first that doesn't
+            powers.push_back(1);
+            while (powers.back() <= UINT64_MAX / radix) {
+                powers.push_back(powers.back() * radix);
+            }
+        }
+
+        /**
+         * @brief The digits of v, least significant first, none at all for 0.
+         */
+        void split(std::uint64_t v, std::vector<std::int32_t> &digits) const {
+            switch (radix) {
+                case 2:  return detail::split_digits(detail::ConstRadix<2>(), v, digits);
+                case 3:  return detail::split_digits(detail::ConstRadix<3>(), v, digits);
+                case 4:  return detail::split_digits(detail::ConstRadix<4>(), v, digits);
+                case 8:  return detail::split_digits(detail::ConstRadix<8>(), v, digits);
+                case 10: return detail::split_digits(detail::ConstRadix<10>(), v, digits);
+                case 16: return detail::split_digits(detail::ConstRadix<16>(), v, digits);
+                default:
+                    if (shift > 0) {
+                        return detail::split_digits(detail::ShiftRadix{radix, shift}, v, digits);
+                    }
+                    return detail::split_digits(detail::RuntimeRadix{radix}, v, digits);
+            }
+        }
+
+        /**
+         * @brief The balanced digits of v, each in (-r/2, r/2] (the non-adjacent form
+         *        for radix 2), least significant first. May be one digit longer than split.
+         */
+        void split_balanced(std::uint64_t v, std::vector<std::int32_t> &digits) const {
+            switch (radix) {
+                case 2:  return detail::split_balanced_digits(detail::ConstRadix<2>(), v, digits);
+                case 3:  return detail::split_balanced_digits(detail::ConstRadix<3>(), v, digits);
+                case 4:  return detail::split_balanced_digits(detail::ConstRadix<4>(), v, digits);
+                case 8:  return detail::split_balanced_digits(detail::ConstRadix<8>(), v, digits);
+                case 10: return detail::split_balanced_digits(detail::ConstRadix<10>(), v, digits);
+                case 16: return detail::split_balanced_digits(detail::ConstRadix<16>(), v, digits);
+                default:
+                    if (shift > 0) {
+                        return detail::split_balanced_digits(detail::ShiftRadix{radix, shift}, v, digits);
+                    }
+                    return detail::split_balanced_digits(detail::RuntimeRadix{radix}, v, digits);
+            }
+        }
+
+        /**
+         * @brief How many digits v has, 0 for 0.
+         */
+        size_t digit_count(std::uint64_t v) const {
+            size_t count = 0;
+            while (count < powers.size() && powers[count] <= v) {
+                count++;
+            }
+            return count;
+        }
+
+        /**
+         * @brief The largest value with the given number of digits, r^digits - 1,
+         *        or UINT64_MAX if that doesn't fit.
+         */
+        std::uint64_t max_value(size_t digits) const {
+            return digits < powers.size() ? powers[digits] - 1 : UINT64_MAX;
+        }
+
+        /**
+         * @brief r^k, which has to fit in 64 bits.
+         */
+        std::uint64_t power(size_t k) const {
+            return powers.at(k);
+        }
+
+        std::uint32_t get_radix() const {
+            return radix;
+        }
+
+    private:
+        std::uint32_t radix;
+
+        // log2 of the radix if it is a power of two, 0 otherwise
+        unsigned shift;
+
+        std::vector<std::uint64_t> powers;
+    };
+} // namespace che_utils
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef HUGEPAGES_H
+#define HUGEPAGES_H
+
+#include <stddef.h>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace che_utils {
+    /**
+     * How a HugePageBuffer asks for its pages. hugetlb takes pages from the reserved
+     * pool (vm.nr_hugepages) and falls back to transparent ones when it is empty,
+     * transparent asks the kernel to back the buffer with huge pages when it can.
+     */
+    enum class huge_pages : uint8_t {
+        none,
+        transparent,
+        hugetlb
+    };
+
+    /**
+     * An anonymous mapping for large, long-lived buffers such as noise polynomials,
+     * aligned to and sized in whole huge pages so sweeping over it touches a handful
+     * of TLB entries instead of one per 4KiB. Unmapped when it goes out of scope.
+     */
+    class HugePageBuffer {
+    public:
+        static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+        /**
+         * @brief Maps at least bytes of zeroed memory.
+         *
+         * @param bytes the size needed
+         * @param mode the kind of pages to ask for
+         * @throws std::bad_alloc if nothing could be mapped
+         */
+        HugePageBuffer(size_t bytes, huge_pages mode) {
+            size_t page = sysconf(_SC_PAGESIZE);
+            size_t unit = mode == huge_pages::none ? page : HUGE_PAGE_SIZE;
+            size_ = (bytes + unit - 1) / unit * unit;
+
+#ifdef MAP_HUGETLB
+            if (mode == huge_pages::hugetlb) {
+                void *mapped = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (mapped != MAP_FAILED) {
+                    data_ = mapped;
+                    hugetlb_ = true;
+                    return;
+                }
+            }
+#endif
+
+            // one huge page extra, so an aligned range is sure to fit; the rest is given back
+            size_t padding = unit == page ? 0 : unit;
+            void *mapped = mmap(nullptr, size_ + padding, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapped == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+
+            char *start = static_cast<char *>(mapped);
+            char *aligned = start;
+            if (padding > 0) {
+                aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(start) + unit - 1) / unit * unit);
+                if (aligned > start) {
+                    munmap(start, aligned - start);
+                }
+                size_t tail = (start + size_ + padding) - (aligned + size_);
+                if (tail > 0) {
+                    munmap(aligned + size_, tail);
+                }
+            }
+            data_ = aligned;
+
+#ifdef MADV_HUGEPAGE
+            if (mode != huge_pages::none) {
+                madvise(data_, size_, MADV_HUGEPAGE);
+            }
+#endif
+        }
+
+        ~HugePageBuffer() {
+            if (data_ != nullptr) {
+                munmap(data_, size_);
+            }
+        }
+
+        HugePageBuffer(const HugePageBuffer &) = delete;
+        HugePageBuffer &operator=(const HugePageBuffer &) = delete;
+
+        std::uint64_t *data() const {
+            return static_cast<std::uint64_t *>(data_);
+        }
+
+        /**
+         * @brief Bytes mapped, the requested size rounded up to whole pages.
+         */
+        size_t size() const {
+            return size_;
+        }
+
+        /**
+         * @brief Whether the buffer came from the reserved huge page pool.
+         */
+        bool on_hugetlb() const {
+            return hugetlb_;
+        }
+
+    private:
+        void *data_ = nullptr;
+        size_t size_ = 0;
+        bool hugetlb_ = false;
+    };
+} // namespace che_utils
+
+#endif
@@ -1,98 +1,265 @@
 #include "inche.h"
 #include "utils.h"
+#include "polyadd.h"
 #include <seal/util/rlwe.h>
-#include <seal/util/polyarithsmallmod.h>
+#include <seal/util/ntt.h>
+#include <algorithm>
 
 using namespace seal;
 using namespace seal::util;
 using namespace che_utils;
 
 namespace inche {
-    Inche::Inche(scheme_type scheme, size_t poly_modulus_degree) {
-        EncryptionParameters params(scheme);
-        params.set_poly_modulus_degree(poly_modulus_degree);
-
-        this->scheme = scheme;
-
-        
-        auto coeffs = CoeffModulus::BFVDefault(poly_modulus_degree);
-        params.set_coeff_modulus(coeffs);
-        
-        // branch based on scheme type
-        switch (scheme) {
-            case scheme_type::ckks:
-                scale = pow(2.0, log2(*(coeffs[2].data())));
-                break;
-
-            case scheme_type::bfv: case scheme_type::bgv:
-                params.set_plain_modulus(16384);
-                break;
+    namespace {
+        // the parameters Inche has always used for a given degree
+        EncryptionParameters default_params(scheme_type scheme, size_t poly_modulus_degree) {
+            EncryptionParameters params(scheme);
+            params.set_poly_modulus_degree(poly_modulus_degree);
+            params.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
+
+            // a prime that allows batching, with room for 30-bit integers
+            if (scheme != scheme_type::ckks) {
+                params.set_plain_modulus(PlainModulus::Batching(poly_modulus_degree, 30));
+            }
+            return params;
         }
+    } // namespace
 
-        // gather params
-        context_ = new SEALContext(params);
+    Inche::Inche(scheme_type scheme, size_t poly_modulus_degree)
+        : Inche(std::make_shared<const KeyContext>(default_params(scheme, poly_modulus_degree))) {}
 
-        // generate keys
-        KeyGenerator keygen(*context_);
-        SecretKey secret_key = keygen.secret_key();
-        PublicKey public_key;
-        keygen.create_public_key(public_key);
+    Inche::Inche(std::shared_ptr<const KeyContext> keys) {
+        this->keys = keys;
+        scheme = keys->params().scheme();
+        auto &context = keys->context();
 
-        pk_ = public_key;
+        // scale stabilization close to the intermediate primes
+        if (scheme == scheme_type::ckks) {
+            auto &coeffs = keys->params().coeff_modulus();
+            scale = pow(2.0, log2(*(coeffs[std::min<size_t>(2, coeffs.size() - 1)].data())));
+        }
 
         // create the encryption objects
-        enc  = new Encryptor(*context_, public_key);
-        eval = new Evaluator(*context_);
-        dec  = new Decryptor(*context_, secret_key);
+        enc.reset(new Encryptor(context, keys->public_key()));
+        eval.reset(new Evaluator(context));
+        dec.reset(new Decryptor(context, keys->secret_key()));
 
         // set the encoder object, if using CKKS, then
         // encrypt the base ciphertext he(0)
         if (scheme == scheme_type::ckks) {
             Plaintext zero_plain;
-            encoder = new CKKSEncoder(*context_);
+            encoder.reset(new CKKSEncoder(context));
             encoder->encode(0, scale, zero_plain);
             enc->encrypt(zero_plain, zero);
         } else {
-            Plaintext zero_plain(uint64_to_hex_string(1));
+            Plaintext zero_plain;
+            set_constant_plain(0, zero_plain);
             enc->encrypt(zero_plain, zero);
+            if (context.first_context_data()->qualifiers().using_batching) {
+                batch_encoder.reset(new BatchEncoder(context));
+            }
         }
+
+        // every ciphertext starts as zero, so its level is the one we work at
+        context_data_ = context.get_context_data(zero.parms_id());
+        encrypted_size_ = keys->public_key().data().size();
     }
 
     void Inche::encrypt(double value, seal::Ciphertext &destination) {
+        auto scratch = acquire_scratch();
+        encrypt(value, destination, *scratch);
+        release_scratch(std::move(scratch));
+    }
+
+    void Inche::encrypt_batch(const std::vector<double> &values, std::vector<Ciphertext> &destination) {
+        // keeps whatever storage the caller already has in place
+        destination.resize(values.size());
+
+        parallel_for(values.size(), [&](int start, int end) {
+            auto scratch = acquire_scratch();
+            for (int i = start; i < end; i++) {
+                encrypt(values[i], destination[i], *scratch);
+            }
+            release_scratch(std::move(scratch));
+        });
+    }
+
+    void Inche::encrypt(double value, seal::Ciphertext &destination, Scratch &scratch) {
+        // copying into an existing ciphertext reuses its buffer
         destination = zero;
-        Plaintext plain;
+        Plaintext &plain = scratch.plain;
 
-        // ct(0) = pt(value)
-        if (scheme == scheme_type::ckks) {
-            encoder->encode(value, scale, plain);
-            eval->add_plain_inplace(destination, plain); // takes about 5% of fresh enc
-        } else {
-            Plaintext plain(uint64_to_hex_string(value));
-            eval->add_plain_inplace(destination, plain);
+        // ct(0) = pt(value), CKKS plaintexts are added in the same pass as the noise below
+        const uint64_t *plain_data = nullptr;
+        {
+            RACHEAL_STATS_TIMER(phase_stats, PHASE_ENCODE);
+            if (scheme == scheme_type::ckks) {
+                encoder->encode(value, scale, plain, pool());
+                plain_data = plain.data();
+            } else {
+                // BFV/BGV plaintexts are scaled up on the way in, which only the evaluator does
+                set_constant_plain(value, plain);
+                eval->add_plain_inplace(destination, plain, pool());
+            }
+        }
+
+        add_noise(destination, plain_data, scratch);
+    }
+
+    void Inche::encrypt(const std::vector<double> &values, seal::Ciphertext &destination) {
+        if (scheme != scheme_type::ckks) {
+            throw std::invalid_argument("Packing doubles needs CKKS, BFV/BGV pack unsigned integers");
+        }
+        if (values.size() > slot_count()) {
+            throw std::invalid_argument(
+                "Cannot pack more than " + std::to_string(slot_count()) + 
+                    " values, got: " + std::to_string(values.size())
+            );
+        }
+
+        auto scratch = acquire_scratch();
+        destination = zero;
+        {
+            RACHEAL_STATS_TIMER(phase_stats, PHASE_ENCODE);
+            encoder->encode(values, scale, scratch->plain, pool());
+        }
+        add_noise(destination, scratch->plain.data(), *scratch);
+        release_scratch(std::move(scratch));
+    }
+
+    void Inche::encrypt(const std::vector<uint64_t> &values, seal::Ciphertext &destination) {
+        if (batch_encoder == nullptr) {
+            throw std::invalid_argument("Packing integers needs BFV/BGV with a plain modulus that allows batching");
         }
+        if (values.size() > slot_count()) {
+            throw std::invalid_argument(
+                "Cannot pack more than " + std::to_string(slot_count()) + 
+                    " values, got: " + std::to_string(values.size())
+            );
+        }
+
+        auto scratch = acquire_scratch();
+        destination = zero;
+        {
+            RACHEAL_STATS_TIMER(phase_stats, PHASE_ENCODE);
+            batch_encoder->encode(values, scratch->plain);
+            eval->add_plain_inplace(destination, scratch->plain, pool());
+        }
+        add_noise(destination, nullptr, *scratch);
+        release_scratch(std::move(scratch));
+    }
 
-        auto context = *context_;
-        auto prng = UniformRandomGeneratorFactory::DefaultFactory()->create();
-        auto &parms = context.get_context_data(plain.parms_id())->parms();
+    size_t Inche::slot_count() const {
+        if (encoder != nullptr) {
+            return encoder->slot_count();
+        }
+        return batch_encoder != nullptr ? batch_encoder->slot_count() : 1;
+    }
+
+    void Inche::add_noise(seal::Ciphertext &destination, const uint64_t *plain_data, Scratch &scratch) {
+        auto &parms = context_data_->parms();
         auto &coeff_modulus = parms.coeff_modulus();
-        size_t coeff_modulus_size = coeff_modulus.size();
         size_t coeff_count = parms.poly_modulus_degree();
-        auto &context_data = *context.get_context_data(parms.parms_id());
-        auto ntt_tables = context_data.small_ntt_tables();
-        size_t encrypted_size = pk_.data().size();
-
-        auto e(allocate_poly(coeff_count, coeff_modulus_size, MemoryManager::GetPool()));
 
         // c[j]' = c[j] + e[j] (adding noise to ciphertext)
-        for (size_t j = 0; j < encrypted_size; j++) {
-            SEAL_NOISE_SAMPLER(prng, parms, e.get()); // e[j] <-- R_2
-            RNSIter gaussian_iter(e.get(), coeff_count); // should not be costly
-            ntt_negacyclic_harvey(gaussian_iter, coeff_modulus_size, ntt_tables); // ntt(e[j]) 
-            RNSIter dst_iter(destination.data(j), coeff_count); // should not be costly
-
-            // [c[j] + e[j]] mod coeff_modulus
-            add_poly_coeffmod(gaussian_iter, dst_iter, coeff_modulus_size, coeff_modulus, dst_iter); 
+        for (size_t j = 0; j < encrypted_size_; j++) {
+            // take e[j] from the producers when they have one ready
+            size_t slot;
+            bool pooled = noise_pool && noise_pool->try_acquire(slot);
+            const uint64_t *noise;
+            if (pooled) {
+                noise = noise_pool->data(slot);
+            } else {
+                if (noise_pool) {
+                    noise_pool->record_miss();
+                }
+                {
+                    RACHEAL_STATS_TIMER(phase_stats, PHASE_SAMPLE_NOISE);
+                    sample_noise(scratch.prng, *context_data_, false, scratch.noise->data());
+                }
+
+                // done here rather than by sample_noise so it shows up on its own in stats()
+                if (destination.is_ntt_form()) {
+                    RACHEAL_STATS_TIMER(phase_stats, PHASE_NTT);
+                    RNSIter noise_iter(scratch.noise->data(), coeff_count);
+                    ntt_negacyclic_harvey(noise_iter, coeff_modulus.size(), context_data_->small_ntt_tables());
+                }
+                noise = scratch.noise->data();
+            }
+
+            // [c[j] + pt + e[j]] mod coeff_modulus, one pass over c[j]
+            auto &addends = scratch.addends;
+            addends.clear();
+            if (j == 0 && plain_data != nullptr) {
+                addends.push_back(plain_data);
+            }
+            addends.push_back(noise);
+            {
+                RACHEAL_STATS_TIMER(phase_stats, PHASE_POLY_ADD);
+                add_poly_multi(destination.data(j), addends, {}, coeff_count, coeff_modulus);
+            }
+
+            if (pooled) {
+                noise_pool->release(slot);
+            }
+        }
+    }
+
+    void Inche::start_noise_producers(size_t nb_producers, size_t capacity) {
+        noise_pool.reset();
+        noise_pool.reset(new NoisePool(context_data_, zero.is_ntt_form(), capacity, nb_producers, noise_pages));
+    }
+
+    void Inche::stop_noise_producers() {
+        noise_pool.reset();
+    }
+
+    void Inche::set_memory_pool(MemoryPoolHandle pool) {
+        if (!pool) {
+            throw std::invalid_argument("Memory pool is uninitialized");
         }
+        memory_pool = pool;
+        thread_local_pools = false;
+    }
+
+    void Inche::use_thread_local_pools() {
+        thread_local_pools = true;
+    }
+
+    void Inche::set_huge_pages(huge_pages mode) {
+        noise_pages = mode;
+
+        // scratch space is mapped once, so drop what was mapped the old way
+        std::lock_guard<std::mutex> guard(scratch_lock);
+        scratch_pool.clear();
+    }
+
+    size_t Inche::noise_misses() const {
+        return noise_pool ? noise_pool->misses() : 0;
+    }
+
+    std::unique_ptr<Inche::Scratch> Inche::acquire_scratch() {
+        {
+            std::lock_guard<std::mutex> guard(scratch_lock);
+            if (!scratch_pool.empty()) {
+                auto scratch = std::move(scratch_pool.back());
+                scratch_pool.pop_back();
+                return scratch;
+            }
+        }
+
+        // first use on this thread, everything after this is reused
+        auto &parms = context_data_->parms();
+        auto scratch = std::unique_ptr<Scratch>(new Scratch());
+        scratch->prng = UniformRandomGeneratorFactory::DefaultFactory()->create();
+        size_t poly_bytes = parms.poly_modulus_degree() * parms.coeff_modulus().size() * sizeof(uint64_t);
+        scratch->noise.reset(new HugePageBuffer(poly_bytes, noise_pages));
+        return scratch;
+    }
+
+    void Inche::release_scratch(std::unique_ptr<Scratch> scratch) {
+        std::lock_guard<std::mutex> guard(scratch_lock);
+        scratch_pool.push_back(std::move(scratch));
     }
 
     void Inche::decrypt(seal::Ciphertext &encrypted, seal::Plaintext &destination) {
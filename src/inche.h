@@ -3,7 +3,13 @@
 
 #include <stddef.h>
 #include <complex>
+#include <memory>
+#include <mutex>
 #include "seal/seal.h"
+#include "keycontext.h"
+#include "stats.h"
+#include "noisepool.h"
+#include "hugepages.h"
 
 namespace inche {
     /**
@@ -20,6 +26,14 @@ namespace inche {
          */
         Inche(seal::scheme_type scheme, size_t poly_modulus_degree = 32768);
 
+        /**
+         * @brief Construct a new IncHE encryption scheme object under an existing context
+         *        and key pair, e.g. to share keys and NTT tables with other Rache or Inche objects.
+         * 
+         * @param keys the context and keys to use, the scheme is taken from its parameters
+         */
+        Inche(std::shared_ptr<const che_utils::KeyContext> keys);
+
         /**
          * @brief Encrypts a value using the IncHE scheme, storing the result in the destination parameter.
          * 
@@ -28,6 +42,120 @@ namespace inche {
          */
         void encrypt(double value, seal::Ciphertext &destination);
 
+        /**
+         * @brief Packs up to slot_count() values into the slots of a single CKKS ciphertext,
+         *        the i-th value going into slot i and the remaining slots holding 0.
+         * 
+         * @param values the values to be encrypted
+         * @param destination the ciphertext to overwrite with the encrypted values
+         * @throws std::invalid_argument if the scheme is not CKKS or there are more values than slots
+         */
+        void encrypt(const std::vector<double> &values, seal::Ciphertext &destination);
+
+        /**
+         * @brief Packs up to slot_count() unsigned integers into the slots of a single
+         *        BFV/BGV ciphertext using batching, the i-th value going into slot i and
+         *        the remaining slots holding 0.
+         * 
+         * @param values the values to be encrypted, each below the plain modulus
+         * @param destination the ciphertext to overwrite with the encrypted values
+         * @throws std::invalid_argument if the plain modulus does not allow batching
+         *         or there are more values than slots
+         */
+        void encrypt(const std::vector<std::uint64_t> &values, seal::Ciphertext &destination);
+
+        /**
+         * @brief Number of values a single ciphertext can hold, N/2 for CKKS, N for BFV/BGV
+         *        with batching and 1 otherwise.
+         */
+        size_t slot_count() const;
+
+        /**
+         * @brief Encrypts a batch of values across the shared thread pool, storing the
+         *        i-th result in destination[i]. The destination is resized to fit, so
+         *        passing the same vector back in reuses its ciphertexts.
+         * 
+         * @param values the values to be encrypted
+         * @param destination the ciphertexts to overwrite with the encrypted values
+         */
+        void encrypt_batch(const std::vector<double> &values, std::vector<seal::Ciphertext> &destination);
+
+        /**
+         * @brief Starts background threads that sample and NTT-transform noise ahead of
+         *        time, so encrypt only has to add it. When the producers fall behind,
+         *        encrypt samples inline rather than waiting. Must not be called while
+         *        other threads are encrypting.
+         * 
+         * @param nb_producers number of producer threads
+         * @param capacity number of noise polynomials kept ready (two per ciphertext)
+         */
+        void start_noise_producers(size_t nb_producers = 1, size_t capacity = 64);
+
+        /**
+         * @brief Stops the noise producers, encrypt samples inline again. Must not be
+         *        called while other threads are encrypting.
+         */
+        void stop_noise_producers();
+
+        /**
+         * @brief Allocates the temporaries of encrypt (e.g. during CKKS encoding) from
+         *        the given pool instead of SEAL's global one. The pool has to be thread
+         *        safe if several threads encrypt at once. Must not be called while other
+         *        threads are encrypting.
+         * 
+         * @param pool the pool to allocate from
+         * @throws std::invalid_argument if the pool is uninitialized
+         */
+        void set_memory_pool(seal::MemoryPoolHandle pool);
+
+        /**
+         * @brief Gives every thread that calls encrypt its own memory pool for the
+         *        temporaries, so concurrent encryptions never contend on an allocator.
+         *        Each pool lives until its thread exits. Must not be called while other
+         *        threads are encrypting.
+         */
+        void use_thread_local_pools();
+
+        /**
+         * @brief Maps the noise polynomials (the scratch space of encrypt and the slots
+         *        of noise producers started later) with huge pages, which saves TLB
+         *        misses while adding them. Must not be called while other threads
+         *        are encrypting.
+         * 
+         * @param mode the kind of pages to ask for (default che_utils::huge_pages::none)
+         */
+        void set_huge_pages(che_utils::huge_pages mode);
+
+        /**
+         * @brief Number of noise polynomials sampled inline because none was ready.
+         */
+        size_t noise_misses() const;
+
+        /**
+         * @brief Call counts and latency histograms for the phases of encrypt, merged
+         *        across threads: "encode" (the value into a plaintext, and for BFV/BGV
+         *        onto he(0)), "sample_noise" and "ntt" (inline noise only, pooled noise
+         *        costs neither) and "poly_add" (adding plaintext and noise onto he(0)).
+         *        All zeros unless built with RACHEAL_ENABLE_STATS.
+         */
+        che_utils::StatsReport stats() const {
+            return phase_stats.report();
+        }
+
+        /**
+         * @brief Zeroes the counters behind stats().
+         */
+        void reset_stats() {
+            phase_stats.reset();
+        }
+
+        /**
+         * @brief The context and keys this object encrypts under.
+         */
+        std::shared_ptr<const che_utils::KeyContext> key_context() const {
+            return keys;
+        }
+
         /**
          * @brief Decrypts a ciphertext, storing the result in the destination parameter.
          * 
@@ -37,24 +165,74 @@ namespace inche {
         void decrypt(seal::Ciphertext &encrypted, seal::Plaintext &destination);
 
     private:
+        // everything encrypt needs that isn't safe to share between threads
+        struct Scratch {
+            std::shared_ptr<seal::UniformRandomGenerator> prng;
+            std::unique_ptr<che_utils::HugePageBuffer> noise;
+            seal::Plaintext plain;
+            std::vector<const std::uint64_t *> addends;
+        };
+
+        void encrypt(double value, seal::Ciphertext &destination, Scratch &scratch);
+
+        // adds the (NTT form, CKKS only) plaintext and fresh noise onto a copy of zero in one pass
+        void add_noise(seal::Ciphertext &destination, const std::uint64_t *plain_data, Scratch &scratch);
+
+        // the pool for this call's temporaries, see set_memory_pool and use_thread_local_pools
+        seal::MemoryPoolHandle pool() const {
+            return thread_local_pools ? seal::MemoryPoolHandle::ThreadLocal() : memory_pool;
+        }
+
+        // hands out a scratch from the free list, or makes a new one if it's empty
+        std::unique_ptr<Scratch> acquire_scratch();
+        void release_scratch(std::unique_ptr<Scratch> scratch);
+
         // the scheme being used for this Rache object
         seal::scheme_type scheme;
 
-        // needed for randomization addition
-        seal::SEALContext* context_;
-        seal::PublicKey pk_;
+        // context and keys, possibly shared with other objects
+        std::shared_ptr<const che_utils::KeyContext> keys;
+
+        // looked up once, encrypt only reads these
+        std::shared_ptr<const seal::SEALContext::ContextData> context_data_;
+        size_t encrypted_size_;
+
+        // ready-made noise, only set while producers are running
+        std::unique_ptr<NoisePool> noise_pool;
+
+        // only temporaries come from these, scratch space outlives the call and may
+        // move to another thread, which a thread-local pool must never see
+        seal::MemoryPoolHandle memory_pool = seal::MemoryManager::GetPool();
+        bool thread_local_pools = false;
+
+        // how noise polynomials are mapped
+        che_utils::huge_pages noise_pages = che_utils::huge_pages::none;
+
+        // idle scratch space, one ends up per thread calling encrypt
+        std::mutex scratch_lock;
+        std::vector<std::unique_ptr<Scratch>> scratch_pool;
 
         // should be set in every scheme
-        seal::Encryptor* enc;
-        seal::Evaluator* eval;
-        seal::Decryptor* dec;
+        std::unique_ptr<seal::Encryptor> enc;
+        std::unique_ptr<seal::Evaluator> eval;
+        std::unique_ptr<seal::Decryptor> dec;
 
         // base encryption is m + zero
         seal::Ciphertext zero;
 
         // only used when scheme set to CKKS
-        seal::CKKSEncoder* encoder;
-        double scale;
+        std::unique_ptr<seal::CKKSEncoder> encoder;
+        double scale = 0;
+
+        // only set for BFV/BGV when the plain modulus allows batching
+        std::unique_ptr<seal::BatchEncoder> batch_encoder;
+
+        // per-phase timings of encrypt, indexed by the constants below
+        che_utils::Stats phase_stats{{"encode", "sample_noise", "ntt", "poly_add"}};
+        static constexpr size_t PHASE_ENCODE = 0;
+        static constexpr size_t PHASE_SAMPLE_NOISE = 1;
+        static constexpr size_t PHASE_NTT = 2;
+        static constexpr size_t PHASE_POLY_ADD = 3;
     };
 } // namespace inche
 
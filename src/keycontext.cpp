@@ -0,0 +1,25 @@
+#include "keycontext.h"
+
+using namespace seal;
+
+namespace che_utils {
+    KeyContext::KeyContext(const EncryptionParameters &params)
+        : KeyContext(std::make_shared<const SEALContext>(params)) {}
+
+    KeyContext::KeyContext(std::shared_ptr<const SEALContext> context) : context_(context) {
+        // generate keys
+        KeyGenerator keygen(*context_);
+        secret_key_ = keygen.secret_key();
+        keygen.create_public_key(public_key_);
+    }
+
+    KeyContext::KeyContext(std::shared_ptr<const SEALContext> context, 
+                           const SecretKey &secret_key, const PublicKey &public_key)
+        : context_(context), secret_key_(secret_key), public_key_(public_key) {}
+
+    size_t KeyContext::key_bytes() const {
+        auto &pk = public_key_.data();
+        return secret_key_.data().coeff_count() * sizeof(uint64_t) 
+            + pk.size() * pk.poly_modulus_degree() * pk.coeff_modulus_size() * sizeof(uint64_t);
+    }
+} // namespace che_utils
@@ -0,0 +1,73 @@
+#ifndef KEYCONTEXT_H
+#define KEYCONTEXT_H
+
+#include <stddef.h>
+#include <memory>
+#include "seal/seal.h"
+
+namespace che_utils {
+    /**
+     * A SEAL context together with one key pair. Rache and Inche objects built
+     * from the same KeyContext share its keys and its NTT tables, and several
+     * KeyContexts (e.g. one per tenant) can in turn share a single SEALContext.
+     * Everything here is immutable once constructed.
+     */
+    class KeyContext {
+    public:
+        /**
+         * @brief Creates a new context for the parameters and generates a fresh key pair.
+         * 
+         * @param params the encryption parameters to use
+         */
+        explicit KeyContext(const seal::EncryptionParameters &params);
+
+        /**
+         * @brief Generates a fresh key pair under an existing context.
+         * 
+         * @param context the context to share
+         */
+        explicit KeyContext(std::shared_ptr<const seal::SEALContext> context);
+
+        /**
+         * @brief Wraps an existing context and key pair.
+         * 
+         * @param context the context the keys were generated under
+         * @param secret_key the secret key
+         * @param public_key the public key matching secret_key
+         */
+        KeyContext(std::shared_ptr<const seal::SEALContext> context, 
+                   const seal::SecretKey &secret_key, const seal::PublicKey &public_key);
+
+        const seal::SEALContext &context() const {
+            return *context_;
+        }
+
+        std::shared_ptr<const seal::SEALContext> shared_context() const {
+            return context_;
+        }
+
+        const seal::EncryptionParameters &params() const {
+            return context_->key_context_data()->parms();
+        }
+
+        const seal::SecretKey &secret_key() const {
+            return secret_key_;
+        }
+
+        const seal::PublicKey &public_key() const {
+            return public_key_;
+        }
+
+        /**
+         * @brief Approximate bytes held by the key pair, not counting the shared context.
+         */
+        size_t key_bytes() const;
+
+    private:
+        std::shared_ptr<const seal::SEALContext> context_;
+        seal::SecretKey secret_key_;
+        seal::PublicKey public_key_;
+    };
+} // namespace che_utils
+
+#endif
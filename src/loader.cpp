@@ -0,0 +1,109 @@
+#include "loader.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace che_utils {
+    namespace {
+        // first byte after the line break at or after pos, or end if there is none
+        size_t next_line(const char *data, size_t pos, size_t end) {
+            if (pos >= end) {
+                return end;
+            }
+            auto newline = static_cast<const char *>(std::memchr(data + pos, '\n', end - pos));
+            return newline == nullptr ? end : newline - data + 1;
+        }
+
+        void parse_lines(const char *begin, const char *end, std::vector<double> &values) {
+            values.clear();
+            while (begin < end) {
+                auto newline = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+                const char *line_end = newline == nullptr ? end : newline;
+
+                // surrounding whitespace (and \r from Windows line endings) is fine, like with stod
+                const char *first = begin;
+                const char *last = line_end;
+                while (first < last && std::isspace(static_cast<unsigned char>(*first))) {
+                    first++;
+                }
+                while (last > first && std::isspace(static_cast<unsigned char>(last[-1]))) {
+                    last--;
+                }
+                if (first < last && *first == '+') {
+                    first++;
+                }
+
+                if (first < last) {
+                    double value;
+                    auto result = std::from_chars(first, last, value);
+                    if (result.ec != std::errc() || result.ptr != last) {
+                        throw std::invalid_argument("Not a number: " + std::string(begin, line_end));
+                    }
+                    values.push_back(value);
+                }
+
+                begin = line_end + 1;
+            }
+        }
+    } // namespace
+
+    DatasetReader::DatasetReader(const std::string &path, size_t chunk_bytes)
+        : file(path), chunk_bytes(std::max<size_t>(1, chunk_bytes)) {
+        file.advise_sequential();
+    }
+
+    bool DatasetReader::next(std::vector<double> &values) {
+        values.clear();
+        size_t size = file.size();
+        if (offset >= size) {
+            return false;
+        }
+
+        // end the chunk on a line break, so no number is split between chunks
+        const char *data = file.data();
+        size_t end = next_line(data, std::min(size, offset + chunk_bytes) - 1, size);
+
+        // split it again at line breaks, one piece per thread
+        size_t nb_parts = std::min<size_t>(ThreadPool::global().size() + 1, (end - offset) / MIN_PART_BYTES + 1);
+        std::vector<size_t> bounds(nb_parts + 1, end);
+        bounds[0] = offset;
+        for (size_t k = 1; k < nb_parts; k++) {
+            size_t guess = offset + k * (end - offset) / nb_parts;
+            bounds[k] = next_line(data, std::max(guess, bounds[k - 1]), end);
+        }
+
+        parts.resize(nb_parts);
+        ThreadPool::global().parallel_for(nb_parts, [&](int start, int stop) {
+            for (int k = start; k < stop; k++) {
+                parse_lines(data + bounds[k], data + bounds[k + 1], parts[k]);
+            }
+        }, 1);
+
+        size_t nb_values = 0;
+        for (auto &part : parts) {
+            nb_values += part.size();
+        }
+        values.reserve(nb_values);
+        for (auto &part : parts) {
+            values.insert(values.end(), part.begin(), part.end());
+        }
+
+        // done with these pages for good
+        file.discard(offset, end - offset);
+        offset = end;
+        count += values.size();
+        return true;
+    }
+
+    std::vector<double> DatasetReader::read_all(const std::string &path) {
+        DatasetReader reader(path);
+        std::vector<double> values, chunk;
+        while (reader.next(chunk)) {
+            values.insert(values.end(), chunk.begin(), chunk.end());
+        }
+        return values;
+    }
+} // namespace che_utils
@@ -0,0 +1,74 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+
+namespace che_utils {
+    /**
+     * Reads a dataset with one number per line, such as hg38 or covid19. The file is
+     * memory-mapped and handed out in chunks that end on a line break. Each chunk is
+     * parsed in parallel on the shared thread pool with std::from_chars, and its pages
+     * are dropped again once parsed, so memory stays bounded by the chunk size no
+     * matter how large the file is. Blank lines are skipped.
+     */
+    class DatasetReader {
+    public:
+        /**
+         * @brief Maps the dataset at path, nothing is parsed until next is called.
+         *
+         * @param path the file to read
+         * @param chunk_bytes roughly how much of the file each call to next parses
+         * @throws std::runtime_error if the file cannot be opened or mapped
+         */
+        explicit DatasetReader(const std::string &path, size_t chunk_bytes = DEFAULT_CHUNK_BYTES);
+
+        /**
+         * @brief Parses the next chunk of whole lines, replacing the contents of values.
+         *
+         * @param values the values in the chunk, in file order
+         * @return false once the whole file has been read
+         * @throws std::invalid_argument if a line is not a number
+         */
+        bool next(std::vector<double> &values);
+
+        /**
+         * @brief Reads a whole dataset into memory, for data that is known to be small.
+         */
+        static std::vector<double> read_all(const std::string &path);
+
+        /**
+         * @brief Size of the file in bytes.
+         */
+        size_t file_size() const {
+            return file.size();
+        }
+
+        /**
+         * @brief Number of values returned by next so far.
+         */
+        size_t values_read() const {
+            return count;
+        }
+
+        static constexpr size_t DEFAULT_CHUNK_BYTES = 16 << 20;
+
+    private:
+        // pieces smaller than this aren't worth handing to another thread
+        static constexpr size_t MIN_PART_BYTES = 64 << 10;
+
+        MappedFile file;
+        size_t chunk_bytes;
+
+        // start of the first byte not parsed yet
+        size_t offset = 0;
+        size_t count = 0;
+
+        // per-thread parse results, kept so their storage is reused between chunks
+        std::vector<std::vector<double>> parts;
+    };
+} // namespace che_utils
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <stddef.h>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace che_utils {
+    /**
+     * Hit, miss and eviction counts of an LruCache.
+     */
+    struct CacheStats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t evictions = 0;
+        size_t size = 0;
+
+        double hit_rate() const {
+            return hits + misses == 0 ? 0 : static_cast<double>(hits) / (hits + misses);
+        }
+    };
+
+    /**
+     * A bounded map that evicts the least recently used entry, safe to use from many
+     * threads. Keys are spread over independently locked shards, each holding its own
+     * share of the capacity, so threads looking up different keys rarely wait on each
+     * other. Values are handed out as shared pointers, so copying one out never
+     * happens under a lock and evicting it never pulls it from under a reader.
+     */
+    template <class Key, class Value, class Hash = std::hash<Key>>
+    class LruCache {
+    public:
+        /**
+         * @param capacity the most entries to keep, at least one per shard
+         * @param nb_shards the number of independently locked parts (default 16)
+         */
+        explicit LruCache(size_t capacity, size_t nb_shards = 16)
+            : shards(std::max<size_t>(1, std::min(nb_shards, capacity))) {
+            shard_capacity = std::max<size_t>(1, (capacity + shards.size() - 1) / shards.size());
+        }
+
+        LruCache(const LruCache &) = delete;
+        LruCache &operator=(const LruCache &) = delete;
+
+        /**
+         * @brief The value cached for key, marked as most recently used, or null.
+         */
+        std::shared_ptr<const Value> get(const Key &key) {
+            auto &shard = shard_for(key);
+            std::lock_guard<std::mutex> guard(shard.lock);
+            auto found = shard.index.find(key);
+            if (found == shard.index.end()) {
+                shard.misses++;
+                return nullptr;
+            }
+
+            shard.hits++;
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            return found->second->second;
+        }
+
+        /**
+         * @brief Caches value under key, replacing what was there and evicting the
+         *        least recently used entry of its shard when that is full.
+         */
+        void put(const Key &key, std::shared_ptr<const Value> value) {
+            auto &shard = shard_for(key);
+
+            // released only after the lock, it may be the last reference
+            std::shared_ptr<const Value> evicted;
+            std::lock_guard<std::mutex> guard(shard.lock);
+            auto found = shard.index.find(key);
+            if (found != shard.index.end()) {
+                found->second->second.swap(value);
+                shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+                return;
+            }
+
+            if (shard.entries.size() >= shard_capacity) {
+                auto &last = shard.entries.back();
+                evicted = std::move(last.second);
+                shard.index.erase(last.first);
+                shard.entries.pop_back();
+                shard.evictions++;
+            }
+            shard.entries.emplace_front(key, std::move(value));
+            shard.index.emplace(key, shard.entries.begin());
+        }
+
+        /**
+         * @brief Counts summed over the shards, each shard is read at a slightly
+         *        different moment when other threads are using the cache.
+         */
+        CacheStats stats() const {
+            CacheStats stats;
+            for (auto &shard : shards) {
+                std::lock_guard<std::mutex> guard(shard.lock);
+                stats.hits += shard.hits;
+                stats.misses += shard.misses;
+                stats.evictions += shard.evictions;
+                stats.size += shard.entries.size();
+            }
+            return stats;
+        }
+
+        size_t capacity() const {
+            return shard_capacity * shards.size();
+        }
+
+        size_t shard_count() const {
+            return shards.size();
+        }
+
+    private:
+        // a cache line each, so the locks of neighbouring shards don't share one
+        struct alignas(64) Shard {
+            using Entries = std::list<std::pair<Key, std::shared_ptr<const Value>>>;
+
+            // most recently used first
+            mutable std::mutex lock;
+            Entries entries;
+            std::unordered_map<Key, typename Entries::iterator, Hash> index;
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0;
+            std::uint64_t evictions = 0;
+        };
+
+        Shard &shard_for(const Key &key) {
+            // integer hashes are often the identity, so mix before picking a shard
+            std::uint64_t h = static_cast<std::uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ULL;
+            return shards[(h >> 32) % shards.size()];
+        }
+
+        std::vector<Shard> shards;
+        size_t shard_capacity;
+    };
+} // namespace che_utils
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace che_utils {
+    /**
+     * A read-only memory mapping of a whole file, unmapped when it goes out of
+     * scope. Pages are only read in as they are touched.
+     */
+    class MappedFile {
+    public:
+        /**
+         * @brief Maps the file at path into memory.
+         *
+         * @param path the file to map
+         * @throws std::runtime_error if the file cannot be opened or mapped
+         */
+        explicit MappedFile(const std::string &path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open file: " + path);
+            }
+
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                close(fd);
+                throw std::runtime_error("Failed to stat file: " + path);
+            }
+
+            size_ = info.st_size;
+            if (size_ > 0) {
+                void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED) {
+                    close(fd);
+                    throw std::runtime_error("Failed to map file: " + path);
+                }
+                data_ = static_cast<const char *>(mapped);
+            }
+
+            // the mapping stays valid without the descriptor
+            close(fd);
+        }
+
+        ~MappedFile() {
+            if (data_ != nullptr) {
+                munmap(const_cast<char *>(data_), size_);
+            }
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /**
+         * @brief Hints that the whole file will be read front to back soon.
+         */
+        void advise_sequential() const {
+            if (data_ != nullptr) {
+                madvise(const_cast<char *>(data_), size_, MADV_SEQUENTIAL);
+                madvise(const_cast<char *>(data_), size_, MADV_WILLNEED);
+            }
+        }
+
+        /**
+         * @brief Hints that [offset, offset + length) won't be read again, so its pages
+         *        can be dropped from memory. Reading them anyway is still safe, they are
+         *        just read back in from the file.
+         */
+        void discard(size_t offset, size_t length) const {
+            size_t page = sysconf(_SC_PAGESIZE);
+            size_t begin = offset / page * page;
+            size_t end = (offset + length) / page * page;
+            if (data_ != nullptr && end > begin) {
+                madvise(const_cast<char *>(data_) + begin, end - begin, MADV_DONTNEED);
+            }
+        }
+
+        const char *data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+    };
+} // namespace che_utils
+
+#endif
@@ -0,0 +1,306 @@
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "seal/seal.h"
+#include "seal/util/rlwe.h"
+#include "seal/util/ntt.h"
+#include "seal/util/polyarithsmallmod.h"
+#include "racheal.h"
+#include "inche.h"
+#include "keycontext.h"
+#include "polyadd.h"
+#include "utils.h"
+#include "digits.h"
+
+using namespace std;
+using namespace seal;
+using namespace seal::util;
+using namespace racheal;
+using namespace inche;
+using namespace che_utils;
+
+/**
+ * Operation-level micro-benchmarks for the encryption primitives, the same steps
+ * CipherStream prints by hand. Keys and caches are expensive to build, so they are
+ * created once per configuration and shared by every case and repetition using it;
+ * only the operation itself is timed.
+ *
+ * Run e.g. ./microbench --benchmark_filter=Rache --benchmark_repetitions=10
+ */
+namespace {
+    const vector<int64_t> SCHEMES = {
+        static_cast<int64_t>(scheme_type::bfv),
+        static_cast<int64_t>(scheme_type::ckks),
+        static_cast<int64_t>(scheme_type::bgv)
+    };
+
+    const vector<int64_t> DEGREES = {8192, 16384, 32768};
+
+    // the degree Rache and Inche are measured at
+    const size_t RACHE_DEGREE = 16384;
+
+    EncryptionParameters make_params(scheme_type scheme, size_t degree) {
+        EncryptionParameters params(scheme);
+        params.set_poly_modulus_degree(degree);
+        params.set_coeff_modulus(CoeffModulus::BFVDefault(degree));
+        if (scheme != scheme_type::ckks) {
+            params.set_plain_modulus(PlainModulus::Batching(degree, 30));
+        }
+        return params;
+    }
+
+    // one key pair per (scheme, degree), shared by all cases
+    shared_ptr<const KeyContext> keys_for(scheme_type scheme, size_t degree) {
+        static map<pair<scheme_type, size_t>, shared_ptr<const KeyContext>> cache;
+        auto &keys = cache[{scheme, degree}];
+        if (!keys) {
+            keys = make_shared<KeyContext>(make_params(scheme, degree));
+        }
+        return keys;
+    }
+
+    Rache &rache_for(scheme_type scheme, uint32_t radix, size_t cache_size) {
+        static map<tuple<scheme_type, uint32_t, size_t>, unique_ptr<Rache>> cache;
+        auto &rache = cache[{scheme, radix, cache_size}];
+        if (!rache) {
+            rache.reset(new Rache(keys_for(scheme, RACHE_DEGREE), cache_size, radix));
+        }
+        return *rache;
+    }
+
+    Inche &inche_for(scheme_type scheme) {
+        static map<scheme_type, unique_ptr<Inche>> cache;
+        auto &inche = cache[scheme];
+        if (!inche) {
+            inche.reset(new Inche(keys_for(scheme, RACHE_DEGREE)));
+        }
+        return *inche;
+    }
+
+    // values that need every cached digit, so the composition cost is the worst case
+    vector<double> random_values(uint32_t radix, size_t cache_size, size_t count) {
+        double max_val = pow(radix, cache_size) - 1;
+        mt19937_64 engine(42);
+        uniform_real_distribution<double> dist(max_val / radix, max_val);
+
+        vector<double> values(count);
+        for (auto &val : values) {
+            val = floor(dist(engine));
+        }
+        return values;
+    }
+
+    void encode_value(const KeyContext &keys, double value, Plaintext &destination) {
+        auto &context = keys.context();
+        if (keys.params().scheme() == scheme_type::ckks) {
+            CKKSEncoder encoder(context);
+            auto &coeff_modulus = keys.params().coeff_modulus();
+            encoder.encode(value, pow(2.0, coeff_modulus[1].bit_count()), destination);
+        } else {
+            set_constant_plain(static_cast<uint64_t>(value), destination);
+        }
+    }
+} // namespace
+
+// fresh public-key encryption, the baseline every scheme here is compared against
+static void BM_SealEncrypt(benchmark::State &state) {
+    auto scheme = static_cast<scheme_type>(state.range(0));
+    auto keys = keys_for(scheme, state.range(1));
+    Encryptor encryptor(keys->context(), keys->public_key());
+
+    Plaintext plain;
+    encode_value(*keys, 12345, plain);
+    Ciphertext ctxt;
+    for (auto _ : state) {
+        encryptor.encrypt(plain, ctxt);
+        benchmark::DoNotOptimize(ctxt.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SealEncrypt)
+    ->ArgNames({"scheme", "degree"})
+    ->ArgsProduct({SCHEMES, DEGREES})
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_RacheEncrypt(benchmark::State &state) {
+    auto scheme = static_cast<scheme_type>(state.range(0));
+    uint32_t radix = state.range(1);
+    size_t cache_size = state.range(2);
+    auto &rache = rache_for(scheme, radix, cache_size);
+
+    auto values = random_values(radix, cache_size, 1024);
+    Ciphertext ctxt;
+    size_t i = 0;
+    for (auto _ : state) {
+        rache.encrypt(values[i++ % values.size()], ctxt);
+        benchmark::DoNotOptimize(ctxt.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RacheEncrypt)
+    ->ArgNames({"scheme", "radix", "cache"})
+    ->Apply([](benchmark::internal::Benchmark *bench) {
+        // radix^cache stays within 24 bits, which every scheme's plaintexts can hold
+        for (auto scheme : SCHEMES) {
+            for (auto radix_cache : vector<pair<int64_t, int64_t>>{{2, 8}, {2, 16}, {2, 24}, {4, 6}, {4, 12}, {16, 3}, {16, 6}}) {
+                bench->Args({scheme, radix_cache.first, radix_cache.second});
+            }
+        }
+    })
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_RacheEncryptBatch(benchmark::State &state) {
+    auto scheme = static_cast<scheme_type>(state.range(0));
+    auto &rache = rache_for(scheme, 2, 16);
+
+    auto values = random_values(2, 16, state.range(1));
+    vector<Ciphertext> ctxts;
+    for (auto _ : state) {
+        rache.encrypt_batch(values, ctxts);
+        benchmark::DoNotOptimize(ctxts.data());
+    }
+    state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_RacheEncryptBatch)
+    ->ArgNames({"scheme", "values"})
+    ->ArgsProduct({SCHEMES, {256, 4096}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_IncheEncrypt(benchmark::State &state) {
+    auto scheme = static_cast<scheme_type>(state.range(0));
+    auto &inche = inche_for(scheme);
+
+    auto values = random_values(2, 16, 1024);
+    Ciphertext ctxt;
+    size_t i = 0;
+    for (auto _ : state) {
+        inche.encrypt(values[i++ % values.size()], ctxt);
+        benchmark::DoNotOptimize(ctxt.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IncheEncrypt)
+    ->ArgNames({"scheme"})
+    ->ArgsProduct({SCHEMES})
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_AddPlain(benchmark::State &state) {
+    auto scheme = static_cast<scheme_type>(state.range(0));
+    auto keys = keys_for(scheme, state.range(1));
+    Encryptor encryptor(keys->context(), keys->public_key());
+    Evaluator evaluator(keys->context());
+
+    Plaintext plain;
+    encode_value(*keys, 1, plain);
+    Ciphertext ctxt;
+    encryptor.encrypt_zero(ctxt);
+    for (auto _ : state) {
+        evaluator.add_plain_inplace(ctxt, plain);
+        benchmark::DoNotOptimize(ctxt.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AddPlain)
+    ->ArgNames({"scheme", "degree"})
+    ->ArgsProduct({SCHEMES, DEGREES})
+    ->Unit(benchmark::kMicrosecond);
+
+// splitting a value into digits, the first step of every Rache encryption
+static void BM_SplitDigits(benchmark::State &state) {
+    uint32_t radix = state.range(0);
+    DigitSplitter splitter(radix);
+    size_t cache_size = 0;
+    while (cache_size < 24 && splitter.max_value(cache_size + 1) < (1 << 24)) {
+        cache_size++;
+    }
+
+    auto values = random_values(radix, cache_size, 1024);
+    vector<int32_t> digits;
+    size_t i = 0;
+    for (auto _ : state) {
+        splitter.split(values[i++ % values.size()], digits);
+        benchmark::DoNotOptimize(digits.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SplitDigits)
+    ->ArgName("radix")
+    ->ArgsProduct({{2, 3, 7, 10, 16, 32}});
+
+// the fused accumulation Rache and Inche finish every encryption with, k operands at once
+static void BM_AddPolyMulti(benchmark::State &state) {
+    size_t degree = state.range(0);
+    size_t nb_operands = state.range(1);
+    auto keys = keys_for(scheme_type::ckks, degree);
+    auto &coeff_modulus = keys->context().first_context_data()->parms().coeff_modulus();
+    size_t poly_size = degree * coeff_modulus.size();
+
+    mt19937_64 engine(42);
+    vector<vector<uint64_t>> polys(nb_operands + 1, vector<uint64_t>(poly_size));
+    for (auto &poly : polys) {
+        for (size_t i = 0; i < poly_size; i++) {
+            poly[i] = engine() % coeff_modulus[i / degree].value();
+        }
+    }
+
+    vector<const uint64_t *> addends, subtrahends;
+    for (size_t k = 1; k <= nb_operands; k++) {
+        (k % 4 == 0 ? subtrahends : addends).push_back(polys[k].data());
+    }
+    for (auto _ : state) {
+        add_poly_multi(polys[0].data(), addends, subtrahends, degree, coeff_modulus);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * nb_operands);
+    state.SetBytesProcessed(state.iterations() * (nb_operands + 1) * poly_size * sizeof(uint64_t));
+}
+BENCHMARK(BM_AddPolyMulti)
+    ->ArgNames({"degree", "operands"})
+    ->ArgsProduct({DEGREES, {1, 4, 16, 32}})
+    ->Unit(benchmark::kMicrosecond);
+
+// the error polynomial of a fresh encryption
+static void BM_SampleNoise(benchmark::State &state) {
+    auto keys = keys_for(scheme_type::ckks, state.range(0));
+    auto &parms = keys->context().first_context_data()->parms();
+    auto prng = UniformRandomGeneratorFactory::DefaultFactory()->create();
+    auto noise(allocate_poly(parms.poly_modulus_degree(), parms.coeff_modulus().size(), MemoryManager::GetPool()));
+
+    for (auto _ : state) {
+        SEAL_NOISE_SAMPLER(prng, parms, noise.get());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SampleNoise)
+    ->ArgName("degree")
+    ->ArgsProduct({DEGREES})
+    ->Unit(benchmark::kMicrosecond);
+
+// forward NTT over every RNS component, what BGV/CKKS encryption pays per polynomial
+static void BM_NTT(benchmark::State &state) {
+    auto keys = keys_for(scheme_type::ckks, state.range(0));
+    auto &context_data = *keys->context().first_context_data();
+    auto &parms = context_data.parms();
+    size_t coeff_count = parms.poly_modulus_degree();
+    size_t coeff_modulus_size = parms.coeff_modulus().size();
+    auto prng = UniformRandomGeneratorFactory::DefaultFactory()->create();
+    auto poly(allocate_poly(coeff_count, coeff_modulus_size, MemoryManager::GetPool()));
+    SEAL_NOISE_SAMPLER(prng, parms, poly.get());
+
+    RNSIter poly_iter(poly.get(), coeff_count);
+    for (auto _ : state) {
+        ntt_negacyclic_harvey(poly_iter, coeff_modulus_size, context_data.small_ntt_tables());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_NTT)
+    ->ArgName("degree")
+    ->ArgsProduct({DEGREES})
+    ->Unit(benchmark::kMicrosecond);
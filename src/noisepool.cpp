@@ -0,0 +1,79 @@
+#include "noisepool.h"
+#include <chrono>
+#include <seal/util/rlwe.h>
+#include <seal/util/polyarithsmallmod.h>
+
+using namespace seal;
+using namespace seal::util;
+
+namespace inche {
+    void sample_noise(std::shared_ptr<UniformRandomGenerator> prng, 
+                      const SEALContext::ContextData &context_data, 
+                      bool ntt_form, std::uint64_t *destination) {
+        auto &parms = context_data.parms();
+        auto &coeff_modulus = parms.coeff_modulus();
+        size_t coeff_modulus_size = coeff_modulus.size();
+        size_t coeff_count = parms.poly_modulus_degree();
+
+        SEAL_NOISE_SAMPLER(prng, parms, destination); // e <-- R_2
+        RNSIter gaussian_iter(destination, coeff_count); // should not be costly
+
+        // BGV keeps the message in the low bits, so its noise is scaled by t
+        if (parms.scheme() == scheme_type::bgv) {
+            multiply_poly_scalar_coeffmod(
+                gaussian_iter, coeff_modulus_size, parms.plain_modulus().value(), coeff_modulus, gaussian_iter);
+        }
+
+        // BFV ciphertexts are kept in coefficient form, the others in NTT form
+        if (ntt_form) {
+            ntt_negacyclic_harvey(gaussian_iter, coeff_modulus_size, context_data.small_ntt_tables()); // ntt(e) 
+        }
+    }
+
+    NoisePool::NoisePool(std::shared_ptr<const SEALContext::ContextData> context_data, 
+                         bool ntt_form, size_t capacity, size_t nb_producers,
+                         che_utils::huge_pages pages)
+        : context_data(context_data), ntt_form(ntt_form), free_slots(capacity), ready_slots(capacity) {
+        auto &parms = context_data->parms();
+        poly_size = parms.poly_modulus_degree() * parms.coeff_modulus().size();
+
+        // the rings round up, so use every slot they can hold
+        polys.reset(new che_utils::HugePageBuffer(free_slots.capacity() * poly_size * sizeof(std::uint64_t), pages));
+        for (size_t slot = 0; slot < free_slots.capacity(); slot++) {
+            free_slots.try_push(slot);
+        }
+
+        for (size_t i = 0; i < nb_producers; i++) {
+            producers.emplace_back([this] { produce(); });
+        }
+    }
+
+    NoisePool::~NoisePool() {
+        stopping.store(true);
+        idle.notify_all();
+        for (auto &producer : producers) {
+            producer.join();
+        }
+    }
+
+    void NoisePool::release(size_t slot) {
+        free_slots.try_push(slot);
+        idle.notify_one();
+    }
+
+    void NoisePool::produce() {
+        auto prng = UniformRandomGeneratorFactory::DefaultFactory()->create();
+        size_t slot;
+        while (!stopping.load(std::memory_order_relaxed)) {
+            if (!free_slots.try_pop(slot)) {
+                // everything is ready already, the timeout covers a missed wakeup
+                std::unique_lock<std::mutex> guard(idle_lock);
+                idle.wait_for(guard, std::chrono::milliseconds(1));
+                continue;
+            }
+
+            sample_noise(prng, *context_data, ntt_form, polys->data() + slot * poly_size);
+            ready_slots.try_push(slot);
+        }
+    }
+} // namespace inche
@@ -0,0 +1,108 @@
+#ifndef NOISEPOOL_H
+#define NOISEPOOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "seal/seal.h"
+#include "ringbuffer.h"
+#include "hugepages.h"
+
+namespace inche {
+    /**
+     * @brief Samples one noise polynomial the way Inche adds it: e <-- R_2, scaled by
+     *        the plain modulus for BGV, and transformed to NTT form if the ciphertexts are.
+     * 
+     * @param prng the generator to sample from
+     * @param context_data the level the noise is added at
+     * @param ntt_form whether the ciphertexts it is added to are in NTT form
+     * @param destination room for one polynomial at that level
+     */
+    void sample_noise(std::shared_ptr<seal::UniformRandomGenerator> prng, 
+                      const seal::SEALContext::ContextData &context_data, 
+                      bool ntt_form, std::uint64_t *destination);
+
+    /**
+     * Background producers that keep a bounded supply of ready-to-add noise polynomials.
+     * Slots cycle between two lock-free rings: producers take a free slot, fill it with
+     * sample_noise and publish it as ready; encrypt takes a ready slot, adds it, and
+     * gives it back. When nothing is ready the caller samples inline instead of waiting.
+     */
+    class NoisePool {
+    public:
+        /**
+         * @brief Allocates the slots and starts the producer threads.
+         * 
+         * @param context_data the level the noise is added at
+         * @param ntt_form whether the ciphertexts it is added to are in NTT form
+         * @param capacity number of polynomials kept ready (rounded up to a power of two)
+         * @param nb_producers number of producer threads
+         * @param pages the kind of pages the slots are mapped with
+         */
+        NoisePool(std::shared_ptr<const seal::SEALContext::ContextData> context_data, 
+                  bool ntt_form, size_t capacity, size_t nb_producers,
+                  che_utils::huge_pages pages = che_utils::huge_pages::none);
+
+        // stops and joins the producers
+        ~NoisePool();
+
+        NoisePool(const NoisePool &) = delete;
+        NoisePool &operator=(const NoisePool &) = delete;
+
+        /**
+         * @brief Takes a ready polynomial, if there is one.
+         * 
+         * @param slot set to the slot taken, pass it to data() and then release()
+         * @return false if the producers haven't kept up
+         */
+        bool try_acquire(size_t &slot) {
+            return ready_slots.try_pop(slot);
+        }
+
+        const std::uint64_t *data(size_t slot) const {
+            return polys->data() + slot * poly_size;
+        }
+
+        /**
+         * @brief Hands a slot back to the producers once its noise has been added.
+         */
+        void release(size_t slot);
+
+        /**
+         * @brief Number of times a caller found nothing ready so far.
+         */
+        size_t misses() const {
+            return miss_count.load(std::memory_order_relaxed);
+        }
+
+        void record_miss() {
+            miss_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        void produce();
+
+        std::shared_ptr<const seal::SEALContext::ContextData> context_data;
+        bool ntt_form;
+
+        // all slots back to back, poly_size coefficients each
+        size_t poly_size;
+        std::unique_ptr<che_utils::HugePageBuffer> polys;
+
+        che_utils::BoundedRing<size_t> free_slots;
+        che_utils::BoundedRing<size_t> ready_slots;
+
+        // producers only sleep here when every slot is already full
+        std::mutex idle_lock;
+        std::condition_variable idle;
+        std::atomic<bool> stopping{false};
+        std::atomic<size_t> miss_count{0};
+        std::vector<std::thread> producers;
+    };
+} // namespace inche
+
+#endif
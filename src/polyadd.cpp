@@ -0,0 +1,220 @@
+#include "polyadd.h"
+#include <algorithm>
+
+// the vector kernels are compiled for their instruction set whatever the build
+// targets, and picked at runtime from what the CPU supports
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define POLYADD_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace che_utils {
+    namespace {
+        // how one RNS component is accumulated and reduced
+        struct Reduction {
+            std::uint64_t q;
+
+            // q << k for each conditional subtraction, largest first
+            std::vector<std::uint64_t> multiples;
+
+            // operands that may be summed before the accumulator has to be reduced
+            size_t batch;
+        };
+
+        Reduction make_reduction(const seal::Modulus &modulus) {
+            Reduction reduction;
+            reduction.q = modulus.value();
+
+            // keep (batch + 1) * q <= 2^63, the accumulator starts below q
+            reduction.batch = std::max<std::uint64_t>(1, (std::uint64_t(1) << 63) / reduction.q - 1);
+
+            // halving subtractions bring anything below 2^levels * q down below q
+            size_t levels = 0;
+            while ((std::uint64_t(1) << levels) < reduction.batch + 1) {
+                levels++;
+            }
+            for (size_t k = levels; k-- > 0;) {
+                reduction.multiples.push_back(reduction.q << k);
+            }
+            return reduction;
+        }
+
+        inline std::uint64_t reduce(std::uint64_t acc, const Reduction &reduction) {
+            // acc - m wraps around above acc whenever acc < m, so min picks the right one
+            for (auto m : reduction.multiples) {
+                acc = std::min(acc, acc - m);
+            }
+            return acc;
+        }
+
+        // scalar version, also finishes whatever the vector loops leave over
+        void accumulate_scalar(size_t begin, size_t end, std::uint64_t *destination, 
+                               const std::vector<const std::uint64_t *> &addends,
+                               const std::vector<const std::uint64_t *> &subtrahends,
+                               const Reduction &reduction) {
+            for (size_t c = begin; c < end; c++) {
+                std::uint64_t acc = destination[c];
+                size_t pending = 0;
+
+                for (auto addend : addends) {
+                    acc += addend[c];
+                    if (++pending == reduction.batch) {
+                        acc = reduce(acc, reduction);
+                        pending = 0;
+                    }
+                }
+
+                // x - y = x + (q - y), and q - y is still at most q
+                for (auto subtrahend : subtrahends) {
+                    acc += reduction.q - subtrahend[c];
+                    if (++pending == reduction.batch) {
+                        acc = reduce(acc, reduction);
+                        pending = 0;
+                    }
+                }
+
+                destination[c] = reduce(acc, reduction);
+            }
+        }
+
+        // handles no coefficients, leaving them all to accumulate_scalar
+        size_t accumulate_none(size_t, std::uint64_t *, 
+                               const std::vector<const std::uint64_t *> &,
+                               const std::vector<const std::uint64_t *> &,
+                               const Reduction &) {
+            return 0;
+        }
+
+#if defined(POLYADD_DISPATCH)
+        __attribute__((target("avx512f")))
+        inline __m512i reduce512(__m512i acc, const Reduction &reduction) {
+            for (auto m : reduction.multiples) {
+                acc = _mm512_min_epu64(acc, _mm512_sub_epi64(acc, _mm512_set1_epi64(m)));
+            }
+            return acc;
+        }
+
+        __attribute__((target("avx512f")))
+        size_t accumulate_avx512(size_t end, std::uint64_t *destination, 
+                                 const std::vector<const std::uint64_t *> &addends,
+                                 const std::vector<const std::uint64_t *> &subtrahends,
+                                 const Reduction &reduction) {
+            const __m512i q = _mm512_set1_epi64(reduction.q);
+            size_t c = 0;
+            for (; c + 8 <= end; c += 8) {
+                __m512i acc = _mm512_loadu_si512(destination + c);
+                size_t pending = 0;
+
+                for (auto addend : addends) {
+                    acc = _mm512_add_epi64(acc, _mm512_loadu_si512(addend + c));
+                    if (++pending == reduction.batch) {
+                        acc = reduce512(acc, reduction);
+                        pending = 0;
+                    }
+                }
+
+                for (auto subtrahend : subtrahends) {
+                    acc = _mm512_add_epi64(acc, _mm512_sub_epi64(q, _mm512_loadu_si512(subtrahend + c)));
+                    if (++pending == reduction.batch) {
+                        acc = reduce512(acc, reduction);
+                        pending = 0;
+                    }
+                }
+
+                _mm512_storeu_si512(destination + c, reduce512(acc, reduction));
+            }
+            return c;
+        }
+
+        // AVX2 has no unsigned 64-bit compare, but everything stays below 2^63
+        __attribute__((target("avx2")))
+        inline __m256i reduce256(__m256i acc, const Reduction &reduction) {
+            for (auto m : reduction.multiples) {
+                __m256i multiple = _mm256_set1_epi64x(m);
+                __m256i below = _mm256_cmpgt_epi64(multiple, acc);
+                acc = _mm256_sub_epi64(acc, _mm256_andnot_si256(below, multiple));
+            }
+            return acc;
+        }
+
+        __attribute__((target("avx2")))
+        size_t accumulate_avx2(size_t end, std::uint64_t *destination, 
+                               const std::vector<const std::uint64_t *> &addends,
+                               const std::vector<const std::uint64_t *> &subtrahends,
+                               const Reduction &reduction) {
+            const __m256i q = _mm256_set1_epi64x(reduction.q);
+            size_t c = 0;
+            for (; c + 4 <= end; c += 4) {
+                __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(destination + c));
+                size_t pending = 0;
+
+                for (auto addend : addends) {
+                    acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(addend + c)));
+                    if (++pending == reduction.batch) {
+                        acc = reduce256(acc, reduction);
+                        pending = 0;
+                    }
+                }
+
+                for (auto subtrahend : subtrahends) {
+                    __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(subtrahend + c));
+                    acc = _mm256_add_epi64(acc, _mm256_sub_epi64(q, value));
+                    if (++pending == reduction.batch) {
+                        acc = reduce256(acc, reduction);
+                        pending = 0;
+                    }
+                }
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + c), reduce256(acc, reduction));
+            }
+            return c;
+        }
+#endif
+
+        using VectorKernel = size_t (*)(size_t, std::uint64_t *, const std::vector<const std::uint64_t *> &,
+                                        const std::vector<const std::uint64_t *> &, const Reduction &);
+
+        // the widest kernel this CPU (and its OS) can run
+        VectorKernel pick_kernel() {
+#if defined(POLYADD_DISPATCH)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+                return accumulate_avx512;
+            }
+            if (__builtin_cpu_supports("avx2")) {
+                return accumulate_avx2;
+            }
+#endif
+            return accumulate_none;
+        }
+    } // namespace
+
+    void add_poly_multi(std::uint64_t *destination,
+                        const std::vector<const std::uint64_t *> &addends,
+                        const std::vector<const std::uint64_t *> &subtrahends,
+                        size_t coeff_count, const std::vector<seal::Modulus> &coeff_modulus) {
+        if (addends.empty() && subtrahends.empty()) {
+            return;
+        }
+
+        static const VectorKernel accumulate_vector = pick_kernel();
+
+        // offset the operands to one RNS component at a time
+        std::vector<const std::uint64_t *> adds(addends.size());
+        std::vector<const std::uint64_t *> subs(subtrahends.size());
+        for (size_t i = 0; i < coeff_modulus.size(); i++) {
+            size_t offset = i * coeff_count;
+            for (size_t k = 0; k < addends.size(); k++) {
+                adds[k] = addends[k] + offset;
+            }
+            for (size_t k = 0; k < subtrahends.size(); k++) {
+                subs[k] = subtrahends[k] + offset;
+            }
+
+            Reduction reduction = make_reduction(coeff_modulus[i]);
+            std::uint64_t *dst = destination + offset;
+            size_t done = accumulate_vector(coeff_count, dst, adds, subs, reduction);
+            accumulate_scalar(done, coeff_count, dst, adds, subs, reduction);
+        }
+    }
+} // namespace che_utils
@@ -0,0 +1,34 @@
+#ifndef POLYADD_H
+#define POLYADD_H
+
+#include <stddef.h>
+#include <cstdint>
+#include <vector>
+#include "seal/seal.h"
+
+namespace che_utils {
+    /**
+     * @brief Adds and subtracts any number of RNS polynomials into a destination in a
+     *        single streaming pass, i.e.
+     *            destination = destination + sum(addends) - sum(subtrahends) mod q_i
+     *        for every RNS component q_i. Sums are kept unreduced for as long as
+     *        they fit below 2^63 and are then brought back under q_i with a few
+     *        conditional subtractions. Uses AVX-512 or AVX2 when the CPU running it
+     *        supports them, checked once at runtime, with a scalar fallback.
+     *
+     * All polynomials hold coeff_modulus.size() components of coeff_count coefficients,
+     * back to back, with every coefficient already reduced modulo its q_i.
+     *
+     * @param destination the polynomial to accumulate into
+     * @param addends polynomials to add (may repeat)
+     * @param subtrahends polynomials to subtract (may repeat)
+     * @param coeff_count the polynomial modulus degree
+     * @param coeff_modulus the RNS moduli
+     */
+    void add_poly_multi(std::uint64_t *destination,
+                        const std::vector<const std::uint64_t *> &addends,
+                        const std::vector<const std::uint64_t *> &subtrahends,
+                        size_t coeff_count, const std::vector<seal::Modulus> &coeff_modulus);
+} // namespace che_utils
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <stddef.h>
+#include <cstdint>
+#include <limits>
+
+namespace che_utils {
+    /**
+     * xoshiro256**, a small and fast generator for the coin flips and picks that
+     * randomize ciphertexts. Not shared between threads: every thread keeps its own,
+     * seeded from a common seed and its own stream number so no two threads draw
+     * the same sequence. Satisfies UniformRandomBitGenerator, so it also works with
+     * the <random> distributions.
+     */
+    class Xoshiro256 {
+    public:
+        using result_type = std::uint64_t;
+
+        explicit Xoshiro256(std::uint64_t seed = 0, std::uint64_t stream = 0) {
+            this->seed(seed, stream);
+        }
+
+        /**
+         * @brief Restarts the generator on the sequence for (seed, stream).
+         */
+        void seed(std::uint64_t seed, std::uint64_t stream) {
+            // splitmix64 spreads nearby seeds and streams over the whole state
+            std::uint64_t x = seed ^ (stream * 0xd1342543de82ef95ULL);
+            for (auto &word : s) {
+                x += 0x9e3779b97f4a7c15ULL;
+                std::uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                word = z ^ (z >> 31);
+            }
+            coins = 0;
+            nb_coins = 0;
+        }
+
+        std::uint64_t operator()() {
+            std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+            std::uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+            return result;
+        }
+
+        /**
+         * @brief A fair coin flip, 64 of them per draw.
+         */
+        bool coin() {
+            if (nb_coins == 0) {
+                coins = (*this)();
+                nb_coins = 64;
+            }
+            bool heads = coins & 1;
+            coins >>= 1;
+            nb_coins--;
+            return heads;
+        }
+
+        /**
+         * @brief A value in [0, bound), bound > 0, without the bias of a plain modulo.
+         */
+        std::uint64_t below(std::uint64_t bound) {
+            // Lemire's multiply-shift, redrawing the few values that would skew it
+            std::uint64_t threshold = (0 - bound) % bound;
+            while (true) {
+                unsigned __int128 m = static_cast<unsigned __int128>((*this)()) * bound;
+                if (static_cast<std::uint64_t>(m) >= threshold) {
+                    return m >> 64;
+                }
+            }
+        }
+
+        static constexpr result_type min() {
+            return 0;
+        }
+
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+    private:
+        static std::uint64_t rotl(std::uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        std::uint64_t s[4];
+        std::uint64_t coins = 0;
+        size_t nb_coins = 0;
+    };
+} // namespace che_utils
+
+#endif
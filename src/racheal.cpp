@@ -1,127 +1,1128 @@
 #include "racheal.h"
 #include "utils.h"
+#include "mappedfile.h"
+#include "polyadd.h"
+#include <seal/util/polyarithsmallmod.h>
+#include <seal/util/scalingvariant.h>
+#include <seal/util/uintarithsmallmod.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
 
 using namespace seal;
+using namespace seal::util;
 using namespace racheal;
 using namespace che_utils;
 
 namespace racheal {
-    Rache::Rache(scheme_type scheme, size_t init_cache_size, uint32_t radix) {
+    namespace {
+        // fixed-size preamble of a file written by Rache::save, followed by the
+        // parameters, keys, he(0), the radix ciphertexts and then their plaintexts,
+        // each as an uncompressed SEAL object
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t scheme;
+            uint32_t radix;
+            uint32_t reserved;
+            uint64_t cache_size;
+            double scale;
+        };
+
+        const char FILE_MAGIC[8] = "RACHEAL";
+
+        // bump whenever the layout above changes
+        const uint32_t FILE_VERSION = 1;
+
+        // tells generators seeded under one seed (and object) from all others, never 0,
+        // which is what a fresh scratch generator starts out as
+        uint64_t next_seed_version() {
+            static std::atomic<uint64_t> versions{1};
+            return versions.fetch_add(1);
+        }
+
+        // the parameters Rache has always used when none are given
+        EncryptionParameters default_params(scheme_type scheme) {
+            EncryptionParameters params(scheme);
+            size_t poly_modulus_degree = 32768;
+            params.set_poly_modulus_degree(poly_modulus_degree);
+            params.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
+
+            // a prime that allows batching, with room for 30-bit integers
+            if (scheme != scheme_type::ckks) {
+                params.set_plain_modulus(PlainModulus::Batching(poly_modulus_degree, 30));
+            }
+            return params;
+        }
+    } // namespace
+
+    Rache::Rache(scheme_type scheme, size_t init_cache_size, uint32_t radix)
+        : Rache(default_params(scheme), init_cache_size, radix, pow(2, 55)) {}
+
+    Rache::Rache(const EncryptionParameters &params, size_t init_cache_size, uint32_t radix, double scale)
+        : Rache(std::make_shared<const KeyContext>(params), init_cache_size, radix, scale) {}
+
+    Rache::Rache(std::shared_ptr<const KeyContext> keys, size_t init_cache_size, uint32_t radix, double scale) {
         // save radix and scheme type first for later operations
-        this->scheme = scheme;
+        this->keys = keys;
+        scheme = keys->params().scheme();
         r = radix;
+        splitter = DigitSplitter(radix);
 
         // vector should be initialized with a size so we can parallelize
-        radixes_plain = std::vector<Plaintext>(init_cache_size);
-        radixes  = std::vector<Ciphertext>(init_cache_size);
-        cache_size = init_cache_size;
-
-        EncryptionParameters params(scheme);
-        size_t poly_modulus_degree = 32768;
-        params.set_poly_modulus_degree(poly_modulus_degree);
-        
-        // branch based on scheme type
-        switch (scheme) {
-            case scheme_type::ckks:
-                params.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
-                scale = pow(2, 55);
-                break;
+        auto cache = std::make_shared<RadixCache>();
+        cache->radixes_plain = std::vector<Plaintext>(init_cache_size);
+        cache->radixes  = std::vector<Ciphertext>(init_cache_size);
+        cache->cache_size = init_cache_size;
 
-            case scheme_type::bfv: case scheme_type::bgv:
-                params.set_coeff_modulus(CoeffModulus::BFVDefault(poly_modulus_degree));
-                params.set_plain_modulus(16384);
-                break;
+        // scale stabilization close to the intermediate primes
+        if (scheme == scheme_type::ckks) {
+            auto &coeffs = keys->params().coeff_modulus();
+            this->scale = scale != 0 ? scale : pow(2.0, log2(*(coeffs[std::min<size_t>(2, coeffs.size() - 1)].data())));
         }
 
-        // gather params
-        SEALContext context(params);
-
-        // generate keys
-        KeyGenerator keygen(context);
-        SecretKey secret_key = keygen.secret_key();
-        PublicKey public_key;
-        keygen.create_public_key(public_key);
-
         // create the encryption objects
-        enc  = new Encryptor(context, public_key);
-        eval = new Evaluator(context);
-        dec  = new Decryptor(context, secret_key);
+        setup();
 
-        // set the encoder object, if using CKKS, then
         // encrypt the base ciphertext he(0)
-        if (scheme == scheme_type::ckks) {
-            Plaintext zero_plain;
-            encoder = new CKKSEncoder(context);
-            encoder->encode(0, scale, zero_plain);
-            enc->encrypt(zero_plain, zero);
-        } else {
-            Plaintext zero_plain(uint64_to_hex_string(0));
-            enc->encrypt(zero_plain, zero);
-        }
+        Plaintext zero_plain;
+        encode_plain(0, zero_plain);
+        enc->encrypt(zero_plain, cache->zero);
+        context_data = keys->context().get_context_data(cache->zero.parms_id());
 
         // parallelize initialization, not necessary but minor
         // performance benefits can be gained
         parallel_for(init_cache_size, [&](int start, int end) {
             // encrypt powers of 2 up to init_cache_size 
             for(int i = start; i < end; i++) {
-                if (scheme == scheme_type::ckks) {
-                    Plaintext radix_plain;
-                    encoder->encode(pow(r, i), scale, radix_plain);
-                    radixes_plain[i] = radix_plain;
-                    enc->encrypt(radix_plain, radixes[i]);
-                } else {
-                    Plaintext radix_plain(uint64_to_hex_string(pow(r, i)));
-                    radixes_plain[i] = radix_plain;
-                    enc->encrypt(radix_plain, radixes[i]);
+                encode_plain(pow(r, i), cache->radixes_plain[i]);
+                enc->encrypt(cache->radixes_plain[i], cache->radixes[i]);
+            }
+        }, true, 1);
+
+        scale_plains(cache->radixes_plain, cache->radixes_scaled);
+        cache->radixes.push_back(cache->zero);
+        build_zero_sums(*cache);
+
+        auto snap = std::make_shared<Snapshot>();
+        snap->cache = cache;
+        publish(snap);
+    }
+
+    Rache::~Rache() {
+        // the grower and refresher encrypt with this object's encryptor, so they have to finish first
+        stop_refresh();
+        if (shared->grower.joinable()) {
+            shared->grower.join();
+        }
+    }
+
+    Rache::Shared::Shared() {
+        std::random_device device;
+        seed = (uint64_t(device()) << 32) | device();
+
+        seed_version = next_seed_version();
+    }
+
+    void Rache::setup() {
+        auto &context = keys->context();
+        enc.reset(new Encryptor(context, keys->public_key()));
+        eval.reset(new Evaluator(context));
+        dec.reset(new Decryptor(context, keys->secret_key()));
+
+        // set the encoder object, if using CKKS
+        // otherwise the batch encoder, if the plain modulus allows it
+        if (scheme == scheme_type::ckks) {
+            encoder.reset(new CKKSEncoder(context));
+        } else if (context.first_context_data()->qualifiers().using_batching) {
+            batch_encoder.reset(new BatchEncoder(context));
+        }
+    }
+
+    void Rache::build_zero_sums(RadixCache &cache, bool use_threads) const {
+        // zero_sums[0] = he(0), zero_sums[j] = he(r^j) - r * he(r^(j - 1)), all encrypt zero;
+        // entries already there (copied from a smaller cache) are kept
+        auto &zero_sums = cache.zero_sums;
+        auto &radixes = cache.radixes;
+        __int128 m = pow(2.0, cache.cache_size) - 1;
+        size_t first = std::max<size_t>(1, zero_sums.size());
+        zero_sums.resize(std::max<int>(1, floor(log_base_r(r, m))));
+        zero_sums[0] = cache.zero;
+        if (zero_sums.size() <= first) {
+            return;
+        }
+        parallel_for(zero_sums.size() - first, [&](int start, int end) {
+            for (size_t j = start + first; j < end + first; j++) {
+                zero_sums[j] = radixes[j];
+                for (uint32_t k = 0; k < r; k++) {
+                    eval->sub_inplace(zero_sums[j], radixes[j - 1]);
+                }
+            }
+        }, use_threads, 1);
+    }
+
+    void Rache::save(const std::string &path) const {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        FileHeader header = {};
+        std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+        header.version = FILE_VERSION;
+        header.scheme = static_cast<uint32_t>(scheme);
+        auto snap = snapshot();
+        auto &cache = *snap->cache;
+        header.radix = r;
+        header.cache_size = cache.cache_size;
+        header.scale = scale;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        // uncompressed, so loading is a straight copy out of the mapping
+        keys->params().save(out, compr_mode_type::none);
+        keys->secret_key().save(out, compr_mode_type::none);
+        keys->public_key().save(out, compr_mode_type::none);
+        cache.zero.save(out, compr_mode_type::none);
+        for (size_t i = 0; i < cache.cache_size; i++) {
+            cache.radixes[i].save(out, compr_mode_type::none);
+        }
+        for (size_t i = 0; i < cache.cache_size; i++) {
+            cache.radixes_plain[i].save(out, compr_mode_type::none);
+        }
+
+        if (!out) {
+            throw std::runtime_error("Failed to write file: " + path);
+        }
+    }
+
+    std::unique_ptr<Rache> Rache::load(const std::string &path) {
+        MappedFile file(path);
+        file.advise_sequential();
+
+        FileHeader header;
+        if (file.size() < sizeof(header)) {
+            throw std::invalid_argument("Not a Rache cache file: " + path);
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0) {
+            throw std::invalid_argument("Not a Rache cache file: " + path);
+        }
+        if (header.version != FILE_VERSION) {
+            throw std::invalid_argument(
+                "Unsupported Rache cache file version " + std::to_string(header.version) + 
+                    ", expected: " + std::to_string(FILE_VERSION)
+            );
+        }
+
+        std::unique_ptr<Rache> rache(new Rache());
+        rache->r = header.radix;
+        rache->splitter = DigitSplitter(header.radix);
+        rache->scale = header.scale;
+        auto cache = std::make_shared<RadixCache>();
+        cache->cache_size = header.cache_size;
+
+        auto in = reinterpret_cast<const seal_byte *>(file.data());
+        size_t size = file.size();
+        size_t offset = sizeof(header);
+
+        EncryptionParameters params;
+        SecretKey secret_key;
+        PublicKey public_key;
+        offset += params.load(in + offset, size - offset);
+        if (static_cast<uint32_t>(params.scheme()) != header.scheme) {
+            throw std::invalid_argument("Rache cache file header does not match its parameters: " + path);
+        }
+        rache->scheme = params.scheme();
+        auto shared_context = std::make_shared<const SEALContext>(params);
+        auto &context = *shared_context;
+        offset += secret_key.load(context, in + offset, size - offset);
+        offset += public_key.load(context, in + offset, size - offset);
+        rache->keys = std::make_shared<const KeyContext>(shared_context, secret_key, public_key);
+        rache->setup();
+        offset += cache->zero.load(context, in + offset, size - offset);
+        rache->context_data = context.get_context_data(cache->zero.parms_id());
+
+        // every cached object takes at least a SEAL header, so a larger count can't be right
+        size_t cache_size = cache->cache_size;
+        if (cache_size > (size - offset) / (2 * sizeof(Serialization::SEALHeader))) {
+            throw std::invalid_argument("Truncated Rache cache file: " + path);
+        }
+
+        // find where each cached object starts, so they can be loaded in parallel
+        std::vector<size_t> offsets(2 * cache_size + 1);
+        for (size_t i = 0; i < 2 * cache_size; i++) {
+            Serialization::SEALHeader seal_header;
+            if (size - offset < sizeof(seal_header)) {
+                throw std::invalid_argument("Truncated Rache cache file: " + path);
+            }
+            Serialization::LoadHeader(in + offset, size - offset, seal_header);
+            if (!Serialization::IsValidHeader(seal_header) || seal_header.size < sizeof(seal_header) 
+                    || seal_header.size > size - offset) {
+                throw std::invalid_argument("Truncated Rache cache file: " + path);
+            }
+            offsets[i] = offset;
+            offset += seal_header.size;
+        }
+        offsets.back() = offset;
+
+        cache->radixes = std::vector<Ciphertext>(cache_size);
+        cache->radixes_plain = std::vector<Plaintext>(cache_size);
+        parallel_for(cache_size, [&](int start, int end) {
+            for (int i = start; i < end; i++) {
+                size_t j = cache_size + i;
+                cache->radixes[i].load(context, in + offsets[i], offsets[i + 1] - offsets[i]);
+                cache->radixes_plain[i].load(context, in + offsets[j], offsets[j + 1] - offsets[j]);
+            }
+        }, true, 1);
+
+        rache->scale_plains(cache->radixes_plain, cache->radixes_scaled);
+        cache->radixes.push_back(cache->zero);
+        rache->build_zero_sums(*cache);
+
+        auto snap = std::make_shared<Snapshot>();
+        snap->cache = cache;
+        rache->publish(snap);
+        return rache;
+    }
+
+    void Rache::precompute_randomizers(size_t pool_size) {
+        std::lock_guard<std::mutex> guard(shared->update_lock);
+        auto current = snapshot();
+        auto next = std::make_shared<Snapshot>(*current);
+        next->randomizers = build_randomizers(*current->cache, pool_size);
+        publish(next);
+    }
+
+    std::shared_ptr<const std::vector<Ciphertext>> Rache::build_randomizers(
+            const RadixCache &cache, size_t pool_size, bool use_threads) const {
+        auto &zero_sums = cache.zero_sums;
+
+        // each entry is the sum of a random subset of zero_sums, i.e. one full
+        // round of the per-term randomization done ahead of time
+        auto randomizers = std::make_shared<std::vector<Ciphertext>>(pool_size);
+        std::vector<std::vector<bool>> coins(pool_size, std::vector<bool>(zero_sums.size()));
+        Xoshiro256 rng(shared->seed.load(), shared->next_stream.fetch_add(1));
+        for (auto &entry : coins) {
+            for (size_t j = 0; j < entry.size(); j++) {
+                entry[j] = rng.coin();
+            }
+        }
+
+        parallel_for(pool_size, [&](int start, int end) {
+            for (int i = start; i < end; i++) {
+                auto &randomizer = (*randomizers)[i];
+                randomizer = cache.zero;
+                for (size_t j = 0; j < zero_sums.size(); j++) {
+                    if (coins[i][j]) {
+                        eval->add_inplace(randomizer, zero_sums[j]);
+                    }
+                }
+            }
+        }, use_threads, 1);
+        return randomizers;
+    }
+
+    size_t Rache::precompute_windows(size_t memory_budget) {
+        std::lock_guard<std::mutex> guard(shared->update_lock);
+        auto current = snapshot();
+        auto windows = build_windows(*current->cache, memory_budget);
+
+        auto next = std::make_shared<Snapshot>(*current);
+        next->windows = windows;
+        publish(next);
+        return windows->window;
+    }
+
+    std::shared_ptr<const Rache::Windows> Rache::build_windows(const RadixCache &cache, size_t memory_budget, 
+                                                               bool use_threads) const {
+        size_t cache_size = cache.cache_size;
+
+        // every plaintext at this level takes about as much room as radix 1 does
+        size_t plain_bytes = sizeof(Plaintext) + cache.radixes_plain[0].coeff_count() * sizeof(uint64_t);
+
+        // widest window whose tables fit, the last window only needs the digits left over
+        size_t width = 1;
+        for (size_t w = 2; w <= cache_size && pow(r, w) <= MAX_WINDOW_ENTRIES; w++) {
+            size_t entries = (cache_size / w) * (pow(r, w) - 1);
+            if (cache_size % w != 0) {
+                entries += pow(r, cache_size % w) - 1;
+            }
+
+            if (entries * plain_bytes > memory_budget) {
+                break;
+            }
+            width = w;
+        }
+
+        auto windows = std::make_shared<Windows>();
+        windows->window = width;
+        windows->memory_budget = memory_budget;
+        if (width > 1) {
+            // plain[w][v - 1] holds v * r^(w * window)
+            size_t window = width;
+            size_t nb_windows = (cache_size + window - 1) / window;
+            std::vector<std::pair<size_t, size_t>> entries;
+            for (size_t w = 0; w < nb_windows; w++) {
+                size_t width_here = std::min(window, cache_size - w * window);
+                windows->plain.emplace_back(pow(r, width_here) - 1);
+                for (size_t v = 1; v < pow(r, width_here); v++) {
+                    entries.emplace_back(w, v);
                 }
             }
+
+            parallel_for(entries.size(), [&](int start, int end) {
+                for (int i = start; i < end; i++) {
+                    size_t w = entries[i].first, v = entries[i].second;
+                    encode_plain(v * pow(r, w * window), windows->plain[w][v - 1]);
+                }
+            }, use_threads);
+
+            windows->scaled.resize(nb_windows);
+            for (size_t w = 0; w < nb_windows; w++) {
+                scale_plains(windows->plain[w], windows->scaled[w], use_threads);
+            }
+        }
+        return windows;
+    }
+
+    void Rache::set_digit_mode(digit_mode mode) {
+        std::lock_guard<std::mutex> guard(shared->update_lock);
+        auto next = std::make_shared<Snapshot>(*snapshot());
+        next->mode = mode;
+        publish(next);
+    }
+
+    void Rache::set_growth(bool enabled, size_t max_cache_size) {
+        std::lock_guard<std::mutex> guard(shared->growth_lock);
+        shared->growth_enabled = enabled;
+        shared->max_cache_size = max_cache_size;
+    }
+
+    void Rache::grow_cache(size_t cache_size) {
+        std::lock_guard<std::mutex> guard(shared->growth_lock);
+        if (cache_size > growth_cap()) {
+            throw std::invalid_argument(
+                "Cannot grow the cache past " + std::to_string(growth_cap()) + 
+                    " digits, got: " + std::to_string(cache_size)
+            );
+        }
+        if (cache_size > snapshot()->cache->cache_size) {
+            request_growth(cache_size);
+        }
+    }
+
+    Rache::GrowthStats Rache::growth_stats() const {
+        std::lock_guard<std::mutex> guard(shared->growth_lock);
+        return shared->growth;
+    }
+
+    size_t Rache::growth_cap() const {
+        // as many digits as a plaintext holds: below the plain modulus for BFV/BGV,
+        // for CKKS below what the modulus at he(0)'s level leaves above the scale,
+        // and within the 53 bits a double holds exactly
+        size_t digits = 0;
+        if (scheme == scheme_type::ckks) {
+            double bits = std::min(53.0, context_data->total_coeff_modulus_bit_count() - log2(scale) - 1);
+            while (bits >= (digits + 1) * log2(r)) {
+                digits++;
+            }
+        } else {
+            uint64_t t = context_data->parms().plain_modulus().value();
+            for (unsigned __int128 power = r; power <= t; power *= r) {
+                digits++;
+            }
+        }
+
+        // never below what is cached already, an explicit cap only lowers it
+        size_t cap = shared->max_cache_size == 0 ? digits : std::min(digits, shared->max_cache_size);
+        return std::max(cap, snapshot()->cache->cache_size);
+    }
+
+    std::shared_ptr<const Rache::Snapshot> Rache::snapshot_for(double max_value) {
+        auto snap = snapshot();
+        if (max_value <= splitter.max_value(snap->cache->cache_size)) {
+            return snap;
+        }
+
+        std::unique_lock<std::mutex> lock(shared->growth_lock);
+        size_t cap = growth_cap();
+        if (!shared->growth_enabled || !(max_value <= splitter.max_value(cap))) {
+            shared->growth.rejected++;
+            return snapshot();
+        }
+        size_t digits = splitter.digit_count(max_value);
+
+        shared->growth.waits++;
+        request_growth(digits);
+        shared->grown.wait(lock, [&] {
+            return snapshot()->cache->cache_size >= digits || !shared->growing;
         });
+        if (snapshot()->cache->cache_size < digits && shared->growth_error) {
+            std::rethrow_exception(shared->growth_error);
+        }
+        return snapshot();
+    }
+
+    void Rache::request_growth(size_t digits) {
+        shared->growth_target = std::max(shared->growth_target, digits);
+        if (shared->growing) {
+            // the running grower picks up the new target when its round is done
+            return;
+        }
+
+        // a grower that already finished has nothing left to do once it released the lock
+        if (shared->grower.joinable()) {
+            shared->grower.join();
+        }
+        shared->growth_error = nullptr;
+        shared->growing = true;
+        shared->grower = std::thread(&Rache::run_growth, this);
+    }
+
+    void Rache::run_growth() {
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            size_t target, before = snapshot()->cache->cache_size;
+            {
+                std::lock_guard<std::mutex> guard(shared->growth_lock);
+                target = shared->growth_target;
+                if (before >= target) {
+                    shared->growing = false;
+                    shared->growth.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    shared->grown.notify_all();
+                    return;
+                }
+            }
+
+            // one round covers everything asked for so far, later requests wait for the next
+            std::exception_ptr error;
+            try {
+                extend_cache(target);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> guard(shared->growth_lock);
+            if (error) {
+                shared->growth_error = error;
+                shared->growing = false;
+                shared->grown.notify_all();
+                return;
+            }
+            shared->growth.events++;
+            shared->growth.digits_added += snapshot()->cache->cache_size - before;
+            shared->grown.notify_all();
+        }
+    }
+
+    void Rache::extend_cache(size_t cache_size) {
+        // runs on the grower thread, which stays off the shared pool: pool workers
+        // may be the very encryptions waiting for it
+        std::lock_guard<std::mutex> guard(shared->update_lock);
+        auto current = snapshot();
+        auto &old = *current->cache;
+        size_t old_size = old.cache_size;
+        if (cache_size <= old_size) {
+            return;
+        }
+
+        // everything already cached is copied over, only the new powers are encrypted
+        auto cache = std::make_shared<RadixCache>();
+        cache->cache_size = cache_size;
+        cache->zero = old.zero;
+        cache->radixes_plain = old.radixes_plain;
+        cache->radixes_plain.resize(cache_size);
+        cache->radixes.assign(old.radixes.begin(), old.radixes.begin() + old_size);
+        cache->radixes.resize(cache_size);
+        for (size_t i = old_size; i < cache_size; i++) {
+            encode_plain(pow(r, i), cache->radixes_plain[i]);
+            enc->encrypt(cache->radixes_plain[i], cache->radixes[i]);
+        }
+
+        std::vector<Plaintext> added(cache->radixes_plain.begin() + old_size, cache->radixes_plain.end());
+        std::vector<uint64_t> added_scaled;
+        scale_plains(added, added_scaled, false);
+        cache->radixes_scaled = old.radixes_scaled;
+        cache->radixes_scaled.insert(cache->radixes_scaled.end(), added_scaled.begin(), added_scaled.end());
+        cache->radixes.push_back(cache->zero);
+        cache->zero_sums = old.zero_sums;
+        build_zero_sums(*cache, false);
+
+        // the randomizer pool stays valid, it only ever encrypts zero
+        auto next = std::make_shared<Snapshot>(*current);
+        next->cache = cache;
+        if (current->windows->window > 1) {
+            next->windows = build_windows(*cache, current->windows->memory_budget, false);
+        }
+        publish(next);
+    }
+
+    void Rache::set_memo(size_t capacity, size_t nb_shards) {
+        std::lock_guard<std::mutex> guard(shared->update_lock);
+        auto next = std::make_shared<Snapshot>(*snapshot());
+        next->memo = nullptr;
+        if (capacity > 0) {
+            next->memo = std::make_shared<LruCache<uint64_t, Ciphertext>>(capacity, nb_shards);
+        }
+        publish(next);
+    }
+
+    CacheStats Rache::memo_stats() const {
+        auto snap = snapshot();
+        return snap->memo ? snap->memo->stats() : CacheStats();
+    }
+
+    void Rache::set_noise_sampling(size_t every) {
+        if (scheme == scheme_type::ckks) {
+            throw std::invalid_argument("CKKS ciphertexts have no noise budget to sample");
+        }
+
+        std::lock_guard<std::mutex> guard(shared->noise_lock);
+        shared->noise.fresh_budget = dec->invariant_noise_budget(snapshot()->cache->zero);
+        shared->sample_every.store(every);
+    }
+
+    Rache::NoiseStats Rache::noise_stats() const {
+        std::lock_guard<std::mutex> guard(shared->noise_lock);
+        NoiseStats noise = shared->noise;
+        noise.mean_budget = noise.samples == 0 ? 0 : shared->budget_sum / noise.samples;
+        return noise;
+    }
+
+    void Rache::sample_noise(const Ciphertext &encrypted) {
+        // a single relaxed load when sampling is off
+        size_t every = shared->sample_every.load(std::memory_order_relaxed);
+        if (every == 0 || shared->nb_encrypted.fetch_add(1, std::memory_order_relaxed) % every != 0) {
+            return;
+        }
 
-        radixes.push_back(zero);
+        int budget = dec->invariant_noise_budget(encrypted);
+        std::lock_guard<std::mutex> guard(shared->noise_lock);
+        auto &noise = shared->noise;
+        noise.min_budget = noise.samples == 0 ? budget : std::min(noise.min_budget, budget);
+        noise.samples++;
+        shared->budget_sum += budget;
+    }
+
+    void Rache::refresh_cache() {
+        // sequential, so a refresh in the background leaves the shared pool to encryptions
+        std::lock_guard<std::mutex> guard(shared->update_lock);
+        auto current = snapshot();
+        auto &old = *current->cache;
+
+        // the plaintexts stay the same, only their encryptions are redone
+        auto cache = std::make_shared<RadixCache>();
+        cache->cache_size = old.cache_size;
+        cache->radixes_plain = old.radixes_plain;
+        cache->radixes_scaled = old.radixes_scaled;
+        Plaintext zero_plain;
+        encode_plain(0, zero_plain);
+        enc->encrypt(zero_plain, cache->zero);
+        cache->radixes.resize(cache->cache_size);
+        for (size_t i = 0; i < cache->cache_size; i++) {
+            enc->encrypt(cache->radixes_plain[i], cache->radixes[i]);
+        }
+        cache->radixes.push_back(cache->zero);
+        build_zero_sums(*cache, false);
+
+        auto next = std::make_shared<Snapshot>(*current);
+        next->cache = cache;
+        if (!current->randomizers->empty()) {
+            next->randomizers = build_randomizers(*cache, current->randomizers->size(), false);
+        }
+        if (current->memo) {
+            next->memo = std::make_shared<LruCache<uint64_t, Ciphertext>>(
+                current->memo->capacity(), current->memo->shard_count());
+        }
+        publish(next);
+
+        std::lock_guard<std::mutex> noise_guard(shared->noise_lock);
+        shared->noise.refreshes++;
+        if (scheme != scheme_type::ckks) {
+            shared->noise.fresh_budget = dec->invariant_noise_budget(cache->zero);
+        }
+    }
+
+    void Rache::start_refresh(std::chrono::milliseconds period) {
+        if (period.count() <= 0) {
+            throw std::invalid_argument("Refresh period must be positive, got: " + std::to_string(period.count()) + "ms");
+        }
+
+        stop_refresh();
+        std::lock_guard<std::mutex> guard(shared->refresh_lock);
+        shared->refresh_period = period;
+        shared->refresh_stop = false;
+        shared->refresher = std::thread(&Rache::run_refresh, this);
+    }
+
+    void Rache::stop_refresh() {
+        {
+            std::lock_guard<std::mutex> guard(shared->refresh_lock);
+            shared->refresh_stop = true;
+        }
+        shared->refresh_wake.notify_all();
+        if (shared->refresher.joinable()) {
+            shared->refresher.join();
+        }
+    }
+
+    void Rache::run_refresh() {
+        std::unique_lock<std::mutex> lock(shared->refresh_lock);
+        while (!shared->refresh_wake.wait_for(lock, shared->refresh_period, [&] { return shared->refresh_stop; })) {
+            lock.unlock();
+            try {
+                refresh_cache();
+            } catch (const std::exception &) {
+                // keep encrypting from the current cache, the next period tries again
+            }
+            lock.lock();
+        }
+    }
+
+    void Rache::set_seed(uint64_t seed) {
+        shared->seed.store(seed);
+        shared->next_stream.store(0);
+        shared->seed_version.store(next_seed_version(), std::memory_order_release);
+    }
+
+    void Rache::prepare_rng(Scratch &scratch) {
+        uint64_t version = shared->seed_version.load(std::memory_order_acquire);
+        if (scratch.rng_version != version) {
+            scratch.rng.seed(shared->seed.load(std::memory_order_relaxed), shared->next_stream.fetch_add(1));
+            scratch.rng_version = version;
+        }
+    }
+
+    void Rache::set_memory_pool(MemoryPoolHandle pool) {
+        if (!pool) {
+            throw std::invalid_argument("Memory pool is uninitialized");
+        }
+        memory_pool = pool;
+        thread_local_pools = false;
+    }
+
+    void Rache::use_thread_local_pools() {
+        thread_local_pools = true;
     }
 
     void Rache::encrypt(double value, Ciphertext &destination) {
+        thread_local Scratch scratch;
+        encrypt(value, destination, *snapshot_for(std::fabs(value)), scratch);
+        sample_noise(destination);
+    }
+
+    void Rache::encrypt_batch(const std::vector<double> &values, std::vector<Ciphertext> &destination) {
+        // keeps whatever storage the caller already has in place
+        destination.resize(values.size());
+
+        // the whole batch sees the same cache, grown up front for the largest value
+        auto snap = snapshot_for(max_magnitude(values));
+        parallel_for(values.size(), [&](int start, int end) {
+            // one scratch per chunk, reused for every value in it
+            Scratch scratch;
+            for (int i = start; i < end; i++) {
+                encrypt(values[i], destination[i], *snap, scratch);
+                sample_noise(destination[i]);
+            }
+        });
+    }
+
+    void Rache::encrypt(double value, Ciphertext &destination, const Snapshot &snap, Scratch &scratch) {
         // shouldn't encrypt anything larger than 2^cache_size - 1
-        if (value > pow(r, cache_size) - 1) {
+        auto &cache = *snap.cache;
+        size_t cache_size = cache.cache_size;
+        check_value(value, snap);
+
+        // a value composed before only needs randomizing; the memo is keyed by
+        // magnitude, so negative values (balanced digits only) are never memoized
+        uint64_t key = value < 1 ? 0 : value;
+        bool memoize = snap.memo && value >= 0;
+        if (memoize) {
+            if (auto composed = snap.memo->get(key)) {
+                clear_terms(scratch);
+                assemble(destination, snap, scratch, composed.get());
+                return;
+            }
+        }
+
+        // setting up indexed radixes
+        auto &idx = scratch.idx;
+        {
+            RACHEAL_STATS_TIMER(*phase_stats, PHASE_DECOMPOSE);
+            decompose(value, snap, idx);
+        }
+        int digits = idx.size() - 1;
+
+        // collect everything that goes onto he(0) first, negative digits are taken
+        // off instead of added, then add it all in a single pass. BFV/BGV take the
+        // pre-scaled residues, CKKS the plaintexts themselves
+        size_t nb_residues = context_data->parms().coeff_modulus().size();
+        clear_terms(scratch);
+        auto take = [&](const Plaintext &plain, const uint64_t *scaled, bool negative) {
+            if (scheme == scheme_type::ckks) {
+                (negative ? scratch.minus : scratch.plus).push_back(&plain);
+            } else {
+                (negative ? scratch.minus_scaled : scratch.plus_scaled).push_back(scaled);
+            }
+        };
+
+        auto &windows = *snap.windows;
+        size_t window = windows.window;
+        if (window > 1) {
+            // one lookup per window, the digits inside it pick the multiple
+            for (int base = 0; base <= digits; base += window) {
+                int64_t v = 0;
+                for (int k = std::min<int>(base + window - 1, digits); k >= base; k--) {
+                    v = v * r + idx[k];
+                }
+
+                if (v != 0) {
+                    size_t w = base / window, entry = std::abs(v) - 1;
+                    take(windows.plain[w][entry], windows.scaled[w].data() + entry * nb_residues, v < 0);
+                }
+            }
+        } else {
+            for (int k = 0; k <= digits; k++) {   
+                const uint64_t *scaled = cache.radixes_scaled.data() + k * nb_residues;
+                for (int32_t j = 1; j <= idx[k]; j++) {
+                    take(cache.radixes_plain[k], scaled, false);
+                }
+                for (int32_t j = -1; j >= idx[k]; j--) {
+                    take(cache.radixes_plain[k], scaled, true);
+                }
+            }
+        }
+
+        // remember the composition before it is randomized, and randomize a copy
+        if (memoize) {
+            assemble(destination, snap, scratch, nullptr, false);
+            snap.memo->put(key, std::make_shared<const Ciphertext>(destination));
+            clear_terms(scratch);
+            assemble(destination, snap, scratch, &destination);
+            return;
+        }
+        assemble(destination, snap, scratch);
+    }
+
+    void Rache::encrypt(const std::vector<double> &values, Ciphertext &destination) {
+        thread_local Scratch scratch;
+        encrypt(values, destination, *snapshot_for(max_magnitude(values)), scratch);
+    }
+
+    void Rache::encrypt(const std::vector<double> &values, Ciphertext &destination, 
+                        const Snapshot &snap, Scratch &scratch) {
+        if (scheme != scheme_type::ckks) {
+            throw std::invalid_argument("Packing doubles needs CKKS, BFV/BGV pack unsigned integers");
+        }
+        if (values.size() > slot_count()) {
             throw std::invalid_argument(
-                "Value to encrypt cannot be larger than " + std::to_string(pow(r, cache_size) - 1) + 
-                    ", got: " + std::to_string(value)
+                "Cannot pack more than " + std::to_string(slot_count()) + 
+                    " values, got: " + std::to_string(values.size())
             );
         }
 
-        // setting up indexed radixes
-        int digits = floor(log_base_r(r, value));
-        int idx[digits];
-        parallel_for(digits + 1, [&](int start, int end) {
-            for (int j = start; j < end; j++) {
-                idx[j] = ((int) (value / pow(r, j))) % r;
+        // same digits as the single-value case, i.e. fractional parts are dropped
+        auto &slots = scratch.slots;
+        slots.resize(values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            check_value(values[i], snap);
+            slots[i] = std::trunc(values[i]);
+        }
+
+        // the packed digit planes r^k * idx[k] sum to the values themselves, and
+        // encoding is linear, so a single encode stands in for all of them
+        encoder->encode(slots, scale, scratch.packed, pool());
+
+        clear_terms(scratch);
+        scratch.plus.push_back(&scratch.packed);
+        assemble(destination, snap, scratch);
+    }
+
+    void Rache::encrypt(const std::vector<uint64_t> &values, Ciphertext &destination) {
+        thread_local Scratch scratch;
+        uint64_t max_value = values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+        encrypt(values, destination, *snapshot_for(max_value), scratch);
+        sample_noise(destination);
+    }
+
+    void Rache::encrypt(const std::vector<uint64_t> &values, Ciphertext &destination, 
+                        const Snapshot &snap, Scratch &scratch) {
+        if (batch_encoder == nullptr) {
+            throw std::invalid_argument("Packing integers needs BFV/BGV with a plain modulus that allows batching");
+        }
+        if (values.size() > slot_count()) {
+            throw std::invalid_argument(
+                "Cannot pack more than " + std::to_string(slot_count()) + 
+                    " values, got: " + std::to_string(values.size())
+            );
+        }
+        size_t cache_size = snap.cache->cache_size;
+        for (auto value : values) {
+            if (value > splitter.max_value(cache_size)) {
+                throw std::invalid_argument(
+                    "Value to encrypt cannot be larger than " + std::to_string(splitter.max_value(cache_size)) + 
+                        ", got: " + std::to_string(value)
+                );
             }
-        });
+        }
 
-        // start with he(0)
-        destination = zero;
-        for (int k = 0; k <= digits; k++) {   
-            for (int j = 1; j <= idx[k]; j++) {
-                eval->add_plain_inplace(destination, radixes_plain[k]);
+        // the cached radixes already hold r^k in every slot (a constant polynomial batch
+        // encodes to the same constant in each slot), so they randomize packed ciphertexts
+        // as they are, and the per-slot digit planes sum to the batch encoding of the values
+        batch_encoder->encode(values, scratch.packed);
+
+        clear_terms(scratch);
+        scratch.plus.push_back(&scratch.packed);
+        assemble(destination, snap, scratch);
+    }
+
+    void Rache::clear_terms(Scratch &scratch) {
+        scratch.plus.clear();
+        scratch.minus.clear();
+        scratch.plus_scaled.clear();
+        scratch.minus_scaled.clear();
+    }
+
+    void Rache::assemble(Ciphertext &destination, const Snapshot &snap, Scratch &scratch, 
+                         const Ciphertext *base, bool randomize) {
+        auto &cache = *snap.cache;
+        auto &plus = scratch.plus;
+        auto &minus = scratch.minus;
+
+        auto &parms = context_data->parms();
+        auto &coeff_modulus = parms.coeff_modulus();
+        size_t coeff_count = parms.poly_modulus_degree();
+
+        {
+            RACHEAL_STATS_TIMER(*phase_stats, PHASE_COMPOSE);
+            if (base == nullptr) {
+                destination = cache.zero;
+            } else if (base != &destination) {
+                destination = *base;
+            }
+            if (scheme != scheme_type::ckks) {
+                // batch-encoded plaintexts still need the evaluator to scale them up
+                for (auto plain : plus) {
+                    eval->add_plain_inplace(destination, *plain, pool());
+                }
+                for (auto plain : minus) {
+                    eval->sub_plain_inplace(destination, *plain, pool());
+                }
+                plus.clear();
+                minus.clear();
+
+                // cached constants are scaled already, so they sum to one residue per prime
+                // that goes on the constant coefficient (BFV) or, in NTT form, on all of them (BGV)
+                if (!scratch.plus_scaled.empty() || !scratch.minus_scaled.empty()) {
+                    for (size_t i = 0; i < coeff_modulus.size(); i++) {
+                        uint64_t sum = 0;
+                        for (auto scaled : scratch.plus_scaled) {
+                            sum = add_uint_mod(sum, scaled[i], coeff_modulus[i]);
+                        }
+                        for (auto scaled : scratch.minus_scaled) {
+                            sum = sub_uint_mod(sum, scaled[i], coeff_modulus[i]);
+                        }
+
+                        uint64_t *c0 = destination.data(0) + i * coeff_count;
+                        if (destination.is_ntt_form()) {
+                            add_poly_scalar_coeffmod(c0, coeff_count, sum, coeff_modulus[i], c0);
+                        } else {
+                            c0[0] = add_uint_mod(c0[0], sum, coeff_modulus[i]);
+                        }
+                    }
+                }
             }
         }
 
-        // randomizing the constructed ciphertext
-        bool isSwap = rand() % 2;
-        if (isSwap) {
-            eval->add_inplace(destination, zero);
+        RACHEAL_STATS_TIMER(*phase_stats, PHASE_RANDOMIZE);
+
+        // randomizing the constructed ciphertext, a single addition when a pool is ready
+        // and the value wasn't remembered
+        auto &noise = scratch.noise;
+        auto &randomizers = *snap.randomizers;
+        noise.clear();
+        if (randomize) {
+            prepare_rng(scratch);
+            if (!randomizers.empty()) {
+                noise.push_back(&randomizers[scratch.rng.below(randomizers.size())]);
+            }
+
+            // a remembered composition (base) is the same for every encryption of its
+            // value, and the pool alone would leave it one of pool_size ciphertexts, so
+            // it always gets a fresh subset of the zero sums as well
+            if (randomizers.empty() || base != nullptr) {
+                for (size_t j = 0; j < cache.zero_sums.size(); j++) {
+                    bool isSwap = scratch.rng.coin();
+                    if (isSwap) {
+                        noise.push_back(&cache.zero_sums[j]);
+                    }
+                }
+            }
         }
 
-        __int128 m = pow(2.0, cache_size) - 1;
-        for (int j = 1; j < floor(log_base_r(r, m)); j++) {
-            isSwap = rand() % 2;
-            if (isSwap) {
-                eval->add_inplace(destination, radixes[j]);
-                for (int k = 0; k < r; k++) {
-                    eval->sub_inplace(destination, radixes[j - 1]);
+        // CKKS plaintexts sit in NTT form at the level of he(0), so they go onto c[0] directly
+        for (size_t j = 0; j < destination.size(); j++) {
+            auto &adds = scratch.addends;
+            auto &subs = scratch.subtrahends;
+            adds.clear();
+            subs.clear();
+            if (j == 0) {
+                for (auto plain : plus) {
+                    adds.push_back(plain->data());
                 }
+                for (auto plain : minus) {
+                    subs.push_back(plain->data());
+                }
+            }
+            for (auto ctxt : noise) {
+                adds.push_back(ctxt->data(j));
             }
+            add_poly_multi(destination.data(j), adds, subs, coeff_count, coeff_modulus);
+        }
+    }
+
+    size_t Rache::slot_count() const {
+        if (encoder != nullptr) {
+            return encoder->slot_count();
+        }
+        return batch_encoder != nullptr ? batch_encoder->slot_count() : 1;
+    }
+
+    void Rache::check_value(double value, const Snapshot &snap) const {
+        if (value < 0 && snap.mode != digit_mode::balanced) {
+            throw std::invalid_argument(
+                "Negative values need balanced digits, see set_digit_mode, got: " + std::to_string(value)
+            );
+        }
+
+        uint64_t max_value = splitter.max_value(snap.cache->cache_size);
+        if (!(std::fabs(value) <= max_value)) {
+            throw std::invalid_argument(
+                "Value to encrypt cannot be larger than " + std::to_string(max_value) + 
+                    " in magnitude, got: " + std::to_string(value)
+            );
+        }
+    }
+
+    double Rache::max_magnitude(const std::vector<double> &values) {
+        double max_value = 0;
+        for (double value : values) {
+            max_value = std::max(max_value, std::fabs(value));
+        }
+        return max_value;
+    }
+
+    void Rache::decompose(double value, const Snapshot &snap, std::vector<int32_t> &idx) {
+        idx.clear();
+
+        // anything below 1 in magnitude has no digits at all
+        double magnitude = std::fabs(value);
+        if (magnitude < 1) {
+            return;
+        }
+
+        // fractional parts are dropped, the range check made sure the rest fits;
+        // a negative value (balanced digits only) is its magnitude with every digit negated
+        uint64_t v = magnitude;
+        bool fits = false;
+        if (snap.mode == digit_mode::balanced) {
+            splitter.split_balanced(v, idx);
+
+            // a carry out of the top digit needs a radix we don't have, so use
+            // the plain digits for this value instead
+            fits = idx.size() <= snap.cache->cache_size;
+        }
+        if (!fits) {
+            splitter.split(v, idx);
+        }
+        if (value < 0) {
+            for (auto &digit : idx) {
+                digit = -digit;
+            }
+        }
+    }
+
+    void Rache::encode_plain(double value, Plaintext &destination) const {
+        if (scheme == scheme_type::ckks) {
+            encoder->encode(value, scale, destination);
+        } else {
+            set_constant_plain(value, destination);
+        }
+    }
+
+    void Rache::scale_plains(const std::vector<Plaintext> &plains, std::vector<uint64_t> &scaled, 
+                             bool use_threads) const {
+        scaled.clear();
+        if (scheme == scheme_type::ckks) {
+            return;
+        }
+
+        // the residues add_plain would add to c[0] for a constant m: Delta * m on the
+        // constant coefficient for BFV, m on every NTT coefficient for BGV (fresh
+        // ciphertexts have no correction factor)
+        auto &parms = context_data->parms();
+        auto &coeff_modulus = parms.coeff_modulus();
+        size_t coeff_count = parms.poly_modulus_degree();
+        size_t nb_residues = coeff_modulus.size();
+        scaled.resize(plains.size() * nb_residues);
+
+        parallel_for(plains.size(), [&](int start, int end) {
+            // only the constant coefficients are ever written, so zeroing those is enough
+            std::vector<uint64_t> poly(scheme == scheme_type::bfv ? coeff_count * nb_residues : 0, 0);
+            for (int k = start; k < end; k++) {
+                uint64_t *residues = scaled.data() + k * nb_residues;
+                uint64_t m = plains[k].coeff_count() == 0 ? 0 : plains[k][0];
+                if (scheme == scheme_type::bfv) {
+                    multiply_add_plain_with_scaling_variant(plains[k], *context_data, RNSIter(poly.data(), coeff_count));
+                    for (size_t i = 0; i < nb_residues; i++) {
+                        residues[i] = poly[i * coeff_count];
+                        poly[i * coeff_count] = 0;
+                    }
+                } else {
+                    for (size_t i = 0; i < nb_residues; i++) {
+                        residues[i] = m % coeff_modulus[i].value();
+                    }
+                }
+            }
+        }, use_threads);
+    }
+
+    size_t Rache::memory_usage() const {
+        auto ciphertext_bytes = [](const std::vector<Ciphertext> &ctxts) {
+            size_t bytes = 0;
+            for (auto &ctxt : ctxts) {
+                bytes += ctxt.size() * ctxt.poly_modulus_degree() * ctxt.coeff_modulus_size() * sizeof(uint64_t);
+            }
+            return bytes;
+        };
+        auto plaintext_bytes = [](const std::vector<Plaintext> &plains) {
+            size_t bytes = 0;
+            for (auto &plain : plains) {
+                bytes += plain.coeff_count() * sizeof(uint64_t);
+            }
+            return bytes;
+        };
+
+        auto snap = snapshot();
+        auto &cache = *snap->cache;
+        size_t bytes = ciphertext_bytes(cache.radixes) + ciphertext_bytes(cache.zero_sums) 
+            + ciphertext_bytes(*snap->randomizers) + plaintext_bytes(cache.radixes_plain)
+            + cache.radixes_scaled.size() * sizeof(uint64_t);
+        for (auto &window_plain : snap->windows->plain) {
+            bytes += plaintext_bytes(window_plain);
+        }
+        for (auto &window_scaled : snap->windows->scaled) {
+            bytes += window_scaled.size() * sizeof(uint64_t);
+        }
+        if (snap->memo) {
+            auto &zero = cache.zero;
+            bytes += snap->memo->stats().size * zero.size() * zero.poly_modulus_degree() 
+                * zero.coeff_modulus_size() * sizeof(uint64_t);
         }
+        return bytes;
     }
 
     void Rache::decrypt(Ciphertext &encrypted, Plaintext &destination) {
@@ -2,14 +2,47 @@
 #define RACHEAL_H
 
 #include <stddef.h>
+#include <atomic>
+#include <chrono>
 #include <complex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "seal/seal.h"
+#include "keycontext.h"
+#include "stats.h"
+#include "prng.h"
+#include "digits.h"
+#include "lrucache.h"
 
 namespace racheal {
+    /**
+     * How values are split into digits before composition. Balanced digits may be
+     * negative, which are subtracted instead of added; for radix 2 this is the
+     * non-adjacent form, for larger radices each digit lies in (-r/2, r/2].
+     */
+    enum class digit_mode : uint8_t {
+        standard,
+        balanced
+    };
+
     /**
      * Rache allows the user to customize the poly_modulus_degree and scale
      * of the encryption scheme. Note that the poly_modulus_degree that is 
      * chosen has a great effect on the performance of the scheme. 
+     *
+     * One Rache can be shared by any number of threads: encrypt, encrypt_batch and
+     * decrypt may be called concurrently. Each call reads an immutable snapshot of
+     * the radix cache without taking a lock, and randomizes with a generator of its
+     * own thread. precompute_windows, precompute_randomizers and set_digit_mode
+     * may run alongside them as well, they publish a new snapshot that encryptions
+     * started afterwards pick up.
+     *
+     * A value with more digits than are cached grows the cache instead of failing,
+     * see set_growth: the missing radix powers are encrypted on a background thread
+     * while encryptions of smaller values carry on with the current cache.
      */
     class Rache {
     public:
@@ -22,14 +55,356 @@ namespace racheal {
          */
         Rache(seal::scheme_type scheme, size_t init_cache_size = 10, uint32_t radix = 2);
 
+        /**
+         * @brief Construct a new RacheAL encryption scheme object under an existing context
+         *        and key pair, e.g. to share keys and NTT tables with other Rache or Inche objects.
+         * 
+         * @param keys the context and keys to use, the scheme is taken from its parameters
+         * @param init_cache_size the initial number of ciphertexts to be cached (default 10)
+         * @param radix the radix to be used for ciphertext construction (default 2)
+         * @param scale the CKKS scale, 0 uses 2 to the log2 of the third coefficient prime (the last
+         *        if there are fewer), e.g. just under 2^55 for the default 55-bit primes; unlike
+         *        Rache(scheme), which always uses exactly 2^55
+         */
+        Rache(std::shared_ptr<const che_utils::KeyContext> keys, size_t init_cache_size = 10, 
+              uint32_t radix = 2, double scale = 0);
+
+        /**
+         * @brief Construct a new RacheAL encryption scheme object with the given parameters,
+         *        generating a fresh key pair for them. Smaller degrees are much faster as
+         *        long as the values still fit.
+         * 
+         * @param params the full encryption parameters (scheme, degree, moduli, plain modulus)
+         * @param init_cache_size the initial number of ciphertexts to be cached (default 10)
+         * @param radix the radix to be used for ciphertext construction (default 2)
+         * @param scale the CKKS scale, 0 uses 2 to the log2 of the third coefficient prime (the last
+         *        if there are fewer), e.g. just under 2^55 for the default 55-bit primes; unlike
+         *        Rache(scheme), which always uses exactly 2^55
+         */
+        Rache(const seal::EncryptionParameters &params, size_t init_cache_size = 10, 
+              uint32_t radix = 2, double scale = 0);
+
+        // waits for cache growth still running in the background and stops refreshing
+        ~Rache();
+
+        // the grower and refresher threads work on the object that started them, so a
+        // Rache stays where it was built; load hands one out on the heap instead
+        Rache(const Rache &) = delete;
+        Rache &operator=(const Rache &) = delete;
+
         /**
          * @brief Encrypts a value using the Rache scheme, storing the result in the destination parameter.
+         *        Fractional parts are dropped.
          * 
          * @param value the value to be encrypted 
          * @param destination the ciphertext to overwrite with encrypted value
+         * @throws std::invalid_argument if the value is larger than the cache allows, or
+         *         negative without balanced digits (see set_digit_mode)
          */
         void encrypt(double value, seal::Ciphertext &destination);
 
+        /**
+         * @brief Packs up to slot_count() values into the slots of a single CKKS ciphertext,
+         *        the i-th value going into slot i and the remaining slots holding 0. As for
+         *        a single value, each value has its fractional part dropped first.
+         * 
+         * @param values the values to be encrypted
+         * @param destination the ciphertext to overwrite with the encrypted values
+         * @throws std::invalid_argument if the scheme is not CKKS, there are more values
+         *         than slots, a value is larger than the cache allows, or a value is
+         *         negative without balanced digits
+         */
+        void encrypt(const std::vector<double> &values, seal::Ciphertext &destination);
+
+        /**
+         * @brief Packs up to slot_count() unsigned integers into the slots of a single
+         *        BFV/BGV ciphertext using batching, the i-th value going into slot i and
+         *        the remaining slots holding 0.
+         * 
+         * @param values the values to be encrypted
+         * @param destination the ciphertext to overwrite with the encrypted values
+         * @throws std::invalid_argument if the plain modulus does not allow batching, there
+         *         are more values than slots, or a value is larger than the cache allows
+         */
+        void encrypt(const std::vector<std::uint64_t> &values, seal::Ciphertext &destination);
+
+        /**
+         * @brief Encrypts a batch of values across the shared thread pool, storing the
+         *        i-th result in destination[i]. The destination is resized to fit, so
+         *        passing the same vector back in reuses its ciphertexts.
+         * 
+         * @param values the values to be encrypted
+         * @param destination the ciphertexts to overwrite with the encrypted values
+         * @throws std::invalid_argument under the same conditions as encrypt
+         */
+        void encrypt_batch(const std::vector<double> &values, std::vector<seal::Ciphertext> &destination);
+
+        /**
+         * @brief Chooses between plain and balanced (signed) digits for later encryptions.
+         *        Values whose balanced form would need a digit past the cache fall back
+         *        to plain digits. Only balanced digits can encrypt negative values, as
+         *        the digits of their magnitude negated.
+         * 
+         * @param mode the decomposition to use (default digit_mode::standard)
+         */
+        void set_digit_mode(digit_mode mode);
+
+        /**
+         * @brief Controls what happens to values with more digits than are cached. With
+         *        growth on (the default) encrypt waits while the missing radix powers
+         *        are encrypted in the background, other threads keep encrypting smaller
+         *        values meanwhile; past the cap, or with growth off, it throws.
+         * 
+         * @param enabled whether the cache may grow
+         * @param max_cache_size the most digits to ever cache, 0 for as many as the
+         *        parameters can represent (below the plain modulus for BFV/BGV,
+         *        within the modulus and double precision for CKKS)
+         */
+        void set_growth(bool enabled, size_t max_cache_size = 0);
+
+        /**
+         * @brief Starts growing the cache to cache_size digits in the background and
+         *        returns right away, e.g. when larger values are known to be coming.
+         * 
+         * @param cache_size the number of digits to cache
+         * @throws std::invalid_argument if that is past the growth cap
+         */
+        void grow_cache(size_t cache_size);
+
+        /**
+         * Counters of how often and how far the cache has grown.
+         */
+        struct GrowthStats {
+            // completed rounds of growth, each adding one or more digits
+            size_t events = 0;
+            size_t digits_added = 0;
+
+            // encryptions that had to wait for a round to finish
+            size_t waits = 0;
+
+            // values rejected because they need more digits than the cap allows
+            size_t rejected = 0;
+
+            // time spent growing, on the background thread
+            double seconds = 0;
+        };
+
+        GrowthStats growth_stats() const;
+
+        /**
+         * @brief Number of digits currently cached, the largest value that can be
+         *        encrypted without growing is r^get_cache_size() - 1.
+         */
+        size_t get_cache_size() const {
+            return snapshot()->cache->cache_size;
+        }
+
+        /**
+         * @brief Measures the remaining noise budget of every n-th ciphertext encrypt
+         *        returns, see noise_stats. Each measurement costs about a decryption.
+         * 
+         * @param every how often to measure, 0 to stop (the default)
+         * @throws std::invalid_argument if the scheme is CKKS, which has no noise budget
+         */
+        void set_noise_sampling(size_t every);
+
+        /**
+         * Noise budgets, in bits, of the ciphertexts measured by set_noise_sampling.
+         */
+        struct NoiseStats {
+            size_t samples = 0;
+
+            // the budget of a fresh encryption, he(0) of the current cache
+            int fresh_budget = 0;
+
+            // lowest and mean budget left in the measured ciphertexts
+            int min_budget = 0;
+            double mean_budget = 0;
+
+            // completed refresh_cache calls, whether from start_refresh or not
+            size_t refreshes = 0;
+
+            /**
+             * @brief Bits an encryption uses up on average through composition and
+             *        randomization, beyond the noise of a fresh encryption.
+             */
+            double mean_consumed() const {
+                return samples == 0 ? 0 : fresh_budget - mean_budget;
+            }
+        };
+
+        NoiseStats noise_stats() const;
+
+        /**
+         * @brief Re-encrypts he(0) and every cached radix power with fresh randomness
+         *        and swaps them in, together with the zero sums and randomizer pool
+         *        built from them; remembered values (set_memo) start over. Encryptions
+         *        keep going on the previous cache meanwhile, cache growth waits.
+         */
+        void refresh_cache();
+
+        /**
+         * @brief Calls refresh_cache on a background thread once every period, until
+         *        stop_refresh is called or the object is destroyed, which waits for it.
+         *        Calling it again replaces the period. Not to be called from several
+         *        threads at once.
+         * 
+         * @param period the time between refreshes
+         * @throws std::invalid_argument if the period is not positive
+         */
+        void start_refresh(std::chrono::milliseconds period);
+
+        /**
+         * @brief Stops the refreshes started by start_refresh, waiting for one that
+         *        is running to finish.
+         */
+        void stop_refresh();
+
+        /**
+         * @brief Reseeds the randomization. Each thread's generator is seeded from this
+         *        seed and a stream number handed out in the order threads first encrypt
+         *        afterwards, so encrypting from a single thread is reproducible. By
+         *        default the seed comes from std::random_device.
+         * 
+         * @param seed the new seed
+         */
+        void set_seed(std::uint64_t seed);
+
+        /**
+         * @brief Precomputes every multiple of the radix powers inside windows of several
+         *        digits, so composing a value costs one addition per window instead of one
+         *        per unit of every digit. The widest window whose tables fit in the budget
+         *        is used, calling this again replaces the tables.
+         * 
+         * @param memory_budget the most memory, in bytes, the tables may take
+         * @return the number of digits per window, 1 if no tables fit (the default mode)
+         */
+        size_t precompute_windows(size_t memory_budget);
+
+        /**
+         * @brief Precomputes a pool of combined randomizers, each an encryption of zero
+         *        built from a random subset of the cached zero-sum ciphertexts. Once
+         *        the pool exists, randomizing a new ciphertext is a single addition of
+         *        a randomly picked entry. A pool size of 0 returns to per-term randomization.
+         *
+         *        This trades security for speed: a value then has at most pool_size
+         *        distinct encryptions, so two encryptions of the same value are identical
+         *        with probability 1/pool_size, which leaks equality and frequency. Keep
+         *        the pool large, or off, for columns with few distinct values.
+         * 
+         * @param pool_size the number of combined randomizers to keep
+         */
+        void precompute_randomizers(size_t pool_size);
+
+        /**
+         * @brief Remembers the composed, not yet randomized, ciphertexts of recently
+         *        encrypted values, so encrypting one of them again skips the composition
+         *        and only randomizes a copy. The copy always gets a fresh random subset of
+         *        the zero-sum ciphertexts, on top of a pool entry if there is a randomizer
+         *        pool, so repeated values don't repeat ciphertexts. Pays off for columns
+         *        with few distinct values. Only single values are remembered, not packed
+         *        ones. Calling this again starts over.
+         * 
+         * @param capacity the most values to remember, 0 turns remembering off
+         * @param nb_shards the number of independently locked parts, more of them
+         *        let more threads look up values at once (default 16)
+         */
+        void set_memo(size_t capacity, size_t nb_shards = 16);
+
+        /**
+         * @brief Hits, misses and evictions of the values remembered by set_memo,
+         *        all zeros when it is off.
+         */
+        che_utils::CacheStats memo_stats() const;
+
+        /**
+         * @brief Allocates the temporaries of encrypt (packed encoding and BFV/BGV
+         *        plaintext additions) from the given pool instead of SEAL's global one.
+         *        The pool has to be thread safe if several threads encrypt at once.
+         *        Must not be called while other threads are encrypting.
+         * 
+         * @param pool the pool to allocate from
+         * @throws std::invalid_argument if the pool is uninitialized
+         */
+        void set_memory_pool(seal::MemoryPoolHandle pool);
+
+        /**
+         * @brief Gives every thread that calls encrypt its own memory pool for the
+         *        temporaries, so concurrent encryptions never contend on an allocator.
+         *        Each pool lives until its thread exits. Must not be called while other
+         *        threads are encrypting.
+         */
+        void use_thread_local_pools();
+
+        /**
+         * @brief Writes the parameters, keys and radix cache to a versioned binary file,
+         *        so the cache can be reloaded instead of rebuilt. Window tables, the
+         *        randomizer pool, remembered values and the digit mode are not saved.
+         *        The secret key is written unencrypted as well: whoever can read the file
+         *        can decrypt everything this object (or anything sharing its keys) encrypts,
+         *        so keep it as private as the key itself.
+         * 
+         * @param path the file to (over)write
+         * @throws std::runtime_error if the file cannot be written
+         */
+        void save(const std::string &path) const;
+
+        /**
+         * @brief Restores a Rache object written by save. The file is memory-mapped and
+         *        the cached ciphertexts are loaded in parallel straight out of the mapping.
+         *        Returned on the heap, since a Rache can't be moved. The result can decrypt,
+         *        since the file holds the secret key (see save).
+         * 
+         * @param path the file to read
+         * @throws std::invalid_argument if the file is not a (supported) Rache cache file
+         */
+        static std::unique_ptr<Rache> load(const std::string &path);
+
+        /**
+         * @brief Number of values a single ciphertext can hold, N/2 for CKKS, N for BFV/BGV
+         *        with batching and 1 otherwise.
+         */
+        size_t slot_count() const;
+
+        /**
+         * @brief The CKKS scale values are encoded at (unused for BFV/BGV).
+         */
+        double get_scale() const {
+            return scale;
+        }
+
+        /**
+         * @brief The context and keys this object encrypts under.
+         */
+        std::shared_ptr<const che_utils::KeyContext> key_context() const {
+            return keys;
+        }
+
+        /**
+         * @brief Approximate bytes held by the cached plaintexts and ciphertexts, not
+         *        counting the (possibly shared) context and keys.
+         */
+        size_t memory_usage() const;
+
+        /**
+         * @brief Call counts and latency histograms for the phases of encrypt, merged
+         *        across threads: "decompose" (splitting a value into digits), "compose"
+         *        (adding the digit plaintexts onto he(0), for CKKS only the copy of he(0)
+         *        as its plaintexts are added in the randomization pass) and "randomize"
+         *        (picking and adding the encryptions of zero). All zeros unless built
+         *        with RACHEAL_ENABLE_STATS.
+         */
+        che_utils::StatsReport stats() const {
+            return phase_stats->report();
+        }
+
+        /**
+         * @brief Zeroes the counters behind stats().
+         */
+        void reset_stats() {
+            phase_stats->reset();
+        }
+
         /**
          * @brief Decrypts a ciphertext, storing the result in the destination parameter.
          * 
@@ -39,32 +414,231 @@ namespace racheal {
         void decrypt(seal::Ciphertext &encrypted, seal::Plaintext &destination);
 
     private:
-        // stores plaintexts for base ctxt construction
-        std::vector<seal::Plaintext> radixes_plain;
+        // only used by load, which fills everything in itself
+        Rache() = default;
+
+        // creates the encryptor, evaluator, decryptor (and encoder) from the keys
+        void setup();
+
+        // the radix ciphertexts and everything derived from them, built once and
+        // only read afterwards, so any number of threads can encrypt from it
+        struct RadixCache {
+            size_t cache_size = 0;
+
+            // base cipher used to construct new ctxts
+            seal::Ciphertext zero;
 
-        // these ciphertexts are used for randomization
-        std::vector<seal::Ciphertext> radixes;
+            // stores plaintexts for base ctxt construction
+            std::vector<seal::Plaintext> radixes_plain;
 
-        // starting number of radixes to be cached
-        size_t cache_size;
+            // BFV/BGV: radixes_plain already scaled into RNS form, see scale_plains
+            std::vector<std::uint64_t> radixes_scaled;
+
+            // he(r^i) for every cached digit, followed by he(0)
+            std::vector<seal::Ciphertext> radixes;
+
+            // encryptions of zero used one per coin flip when randomizing, see build_zero_sums
+            std::vector<seal::Ciphertext> zero_sums;
+        };
+
+        // digits per window and the multiples within each window, see precompute_windows
+        struct Windows {
+            size_t window = 1;
+            size_t memory_budget = 0;
+            std::vector<std::vector<seal::Plaintext>> plain;
+            std::vector<std::vector<std::uint64_t>> scaled;
+        };
+
+        // everything one encrypt call reads, replaced as a whole whenever any part of
+        // it changes; parts that didn't change are shared with the previous snapshot
+        struct Snapshot {
+            std::shared_ptr<const RadixCache> cache;
+            std::shared_ptr<const Windows> windows = std::make_shared<const Windows>();
+
+            // pre-combined randomizers, see precompute_randomizers
+            std::shared_ptr<const std::vector<seal::Ciphertext>> randomizers = 
+                std::make_shared<const std::vector<seal::Ciphertext>>();
+
+            // how values are split into digits
+            digit_mode mode = digit_mode::standard;
+
+            // composed ciphertexts by value, see set_memo; null when off
+            std::shared_ptr<che_utils::LruCache<std::uint64_t, seal::Ciphertext>> memo;
+        };
+
+        // the published snapshot, the randomness settings and the background threads
+        struct Shared {
+            Shared();
+
+            // only read and replaced with std::atomic_load/atomic_store
+            std::shared_ptr<const Snapshot> snapshot;
+
+            // serializes the calls that build and publish a new snapshot
+            std::mutex update_lock;
+
+            // generators are seeded from seed and the next stream number, and reseeded
+            // whenever seed_version (unique across all objects) changes
+            std::atomic<std::uint64_t> seed;
+            std::atomic<std::uint64_t> seed_version;
+            std::atomic<std::uint64_t> next_stream{0};
+
+            // cache growth, see set_growth; the grower thread is running while growing is set
+            std::mutex growth_lock;
+            std::condition_variable grown;
+            std::thread grower;
+            bool growing = false;
+            size_t growth_target = 0;
+            std::exception_ptr growth_error;
+            bool growth_enabled = true;
+            size_t max_cache_size = 0;
+            GrowthStats growth;
+
+            // noise sampling, see set_noise_sampling; sums kept for the mean
+            std::atomic<size_t> sample_every{0};
+            std::atomic<size_t> nb_encrypted{0};
+            mutable std::mutex noise_lock;
+            NoiseStats noise;
+            double budget_sum = 0;
+
+            // periodic refreshes, see start_refresh
+            std::mutex refresh_lock;
+            std::condition_variable refresh_wake;
+            std::thread refresher;
+            std::chrono::milliseconds refresh_period{0};
+            bool refresh_stop = false;
+        };
+
+        std::shared_ptr<const Snapshot> snapshot() const {
+            return std::atomic_load(&shared->snapshot);
+        }
+
+        void publish(std::shared_ptr<const Snapshot> next) {
+            std::atomic_store(&shared->snapshot, std::move(next));
+        }
+
+        // derives zero_sums from the radix ciphertexts
+        void build_zero_sums(RadixCache &cache, bool use_threads = true) const;
+
+        // a pool of combined randomizers drawn from a cache's zero sums, see precompute_randomizers
+        std::shared_ptr<const std::vector<seal::Ciphertext>> build_randomizers(
+            const RadixCache &cache, size_t pool_size, bool use_threads = true) const;
+
+        // the window tables for a cache, see precompute_windows
+        std::shared_ptr<const Windows> build_windows(const RadixCache &cache, size_t memory_budget, 
+                                                     bool use_threads = true) const;
+
+        // the snapshot to encrypt max_value from, grown first if it needs more digits
+        // and growth allows it; otherwise the current one, which encrypt then rejects
+        std::shared_ptr<const Snapshot> snapshot_for(double max_value);
+
+        // the most digits growth may reach
+        size_t growth_cap() const;
+
+        // asks the grower for at least digits, starting it if needed; needs growth_lock
+        void request_growth(size_t digits);
+
+        // body of the grower thread, extends the cache until the target is reached
+        void run_growth();
+        void extend_cache(size_t cache_size);
+
+        // measures the budget left in encrypted if it is its turn, see set_noise_sampling
+        void sample_noise(const seal::Ciphertext &encrypted);
+
+        // body of the refresh thread, see start_refresh
+        void run_refresh();
+
+        // everything encrypt collects per value, kept around so batches don't reallocate it
+        struct Scratch {
+            std::vector<int32_t> idx;
+            std::vector<const seal::Plaintext *> plus, minus;
+            std::vector<const std::uint64_t *> plus_scaled, minus_scaled;
+            std::vector<const seal::Ciphertext *> noise;
+            std::vector<const std::uint64_t *> addends, subtrahends;
+            std::vector<double> slots;
+            seal::Plaintext packed;
+
+            // this thread's (or batch chunk's) randomness, see Shared
+            che_utils::Xoshiro256 rng;
+            std::uint64_t rng_version = 0;
+        };
+
+        void encrypt(double value, seal::Ciphertext &destination, const Snapshot &snap, Scratch &scratch);
+        void encrypt(const std::vector<double> &values, seal::Ciphertext &destination, 
+                     const Snapshot &snap, Scratch &scratch);
+        void encrypt(const std::vector<std::uint64_t> &values, seal::Ciphertext &destination, 
+                     const Snapshot &snap, Scratch &scratch);
+
+        // adds the terms collected in scratch onto base (he(0) if null) and randomizes, all in one pass
+        void assemble(seal::Ciphertext &destination, const Snapshot &snap, Scratch &scratch, 
+                      const seal::Ciphertext *base = nullptr, bool randomize = true);
+        void clear_terms(Scratch &scratch);
+
+        // reseeds the scratch generator if it was seeded under another seed or object
+        void prepare_rng(Scratch &scratch);
+
+        // throws unless value fits the cache and, if negative, the digits are balanced
+        void check_value(double value, const Snapshot &snap) const;
+
+        // the largest absolute value, which decides how many digits a batch needs
+        static double max_magnitude(const std::vector<double> &values);
+
+        // splits value into its (possibly signed) digits, least significant first
+        void decompose(double value, const Snapshot &snap, std::vector<int32_t> &idx);
+
+        // encodes a plaintext the same way for every scheme-specific cache
+        void encode_plain(double value, seal::Plaintext &destination) const;
+
+        // BFV/BGV only: the RNS residues each (constant) plaintext adds to he(0), back to back
+        void scale_plains(const std::vector<seal::Plaintext> &plains, std::vector<std::uint64_t> &scaled, 
+                          bool use_threads = true) const;
+
+        // the pool for this call's temporaries, see set_memory_pool and use_thread_local_pools
+        seal::MemoryPoolHandle pool() const {
+            return thread_local_pools ? seal::MemoryPoolHandle::ThreadLocal() : memory_pool;
+        }
+
+        // widest window worth considering, r^window entries per window
+        static constexpr size_t MAX_WINDOW_ENTRIES = 1 << 16;
+
+        std::shared_ptr<Shared> shared = std::make_shared<Shared>();
 
         // the radix to be used, for practical reasons shouldn't be made too large
         uint32_t r;
 
+        // splits values into digits in radix r with integer arithmetic only
+        che_utils::DigitSplitter splitter;
+
         // the scheme being used for this Rache object
         seal::scheme_type scheme;
 
+        // context and keys, possibly shared with other objects
+        std::shared_ptr<const che_utils::KeyContext> keys;
+
         // should be set in every scheme
-        seal::Encryptor* enc;
-        seal::Evaluator* eval;
-        seal::Decryptor* dec;
+        std::unique_ptr<seal::Encryptor> enc;
+        std::unique_ptr<seal::Evaluator> eval;
+        std::unique_ptr<seal::Decryptor> dec;
 
-        // base cipher used to construct new ctxts
-        seal::Ciphertext zero;
+        // the level of zero, every constructed ctxt lives there too
+        std::shared_ptr<const seal::SEALContext::ContextData> context_data;
 
         // only used when scheme set to CKKS
-        seal::CKKSEncoder* encoder;
-        double scale;
+        std::unique_ptr<seal::CKKSEncoder> encoder;
+        double scale = 0;
+
+        // only set for BFV/BGV when the plain modulus allows batching
+        std::unique_ptr<seal::BatchEncoder> batch_encoder;
+
+        // where the temporaries of encrypt come from, see set_memory_pool
+        seal::MemoryPoolHandle memory_pool = seal::MemoryManager::GetPool();
+        bool thread_local_pools = false;
+
+        // per-phase timings of encrypt, indexed by the constants below
+        std::shared_ptr<che_utils::Stats> phase_stats = 
+            std::make_shared<che_utils::Stats>(std::vector<std::string>{"decompose", "compose", "randomize"});
+        static constexpr size_t PHASE_DECOMPOSE = 0;
+        static constexpr size_t PHASE_COMPOSE = 1;
+        static constexpr size_t PHASE_RANDOMIZE = 2;
     };
 } // namespace racheal
 
@@ -0,0 +1,114 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+namespace che_utils {
+    /**
+     * A bounded, lock-free multi-producer multi-consumer ring (Vyukov's design). Every
+     * cell carries a sequence number telling producers and consumers whose turn it is,
+     * so neither side ever takes a lock and a full or empty ring fails fast.
+     */
+    template <typename T>
+    class BoundedRing {
+    public:
+        /**
+         * @brief Creates an empty ring.
+         *
+         * @param capacity the most elements held at once, rounded up to a power of two
+         */
+        explicit BoundedRing(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity) {
+                size <<= 1;
+            }
+
+            cells.reset(new Cell[size]);
+            mask = size - 1;
+            for (size_t i = 0; i < size; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedRing(const BoundedRing &) = delete;
+        BoundedRing &operator=(const BoundedRing &) = delete;
+
+        size_t capacity() const {
+            return mask + 1;
+        }
+
+        /**
+         * @brief Appends a value.
+         *
+         * @return false if the ring is full
+         */
+        bool try_push(const T &value) {
+            Cell *cell;
+            size_t pos = tail.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+                if (diff == 0) {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->value = value;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Removes the oldest value.
+         *
+         * @return false if the ring is empty
+         */
+        bool try_pop(T &value) {
+            Cell *cell;
+            size_t pos = head.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+                if (diff == 0) {
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+
+            value = cell->value;
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        size_t mask;
+
+        // kept on separate cache lines so producers and consumers don't false-share
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+} // namespace che_utils
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace che_utils {
+    /**
+     * Call count, total time and a latency histogram for one phase of the hot path,
+     * merged across every thread that ran it.
+     */
+    struct PhaseReport {
+        // bucket b counts calls that took [2^(b-1), 2^b) nanoseconds, bucket 0 is 0ns
+        static constexpr size_t NB_BUCKETS = 64;
+
+        std::string name;
+        std::uint64_t calls = 0;
+        std::uint64_t total_ns = 0;
+        std::array<std::uint64_t, NB_BUCKETS> histogram{};
+
+        double mean_ns() const {
+            return calls == 0 ? 0 : static_cast<double>(total_ns) / calls;
+        }
+
+        /**
+         * @brief Upper bound of the bucket holding the p-th percentile, so within a
+         *        factor of two of the real value.
+         *
+         * @param p the percentile, between 0 and 100
+         */
+        std::uint64_t percentile_ns(double p) const {
+            if (calls == 0) {
+                return 0;
+            }
+
+            std::uint64_t rank = static_cast<std::uint64_t>(p / 100 * (calls - 1)) + 1;
+            std::uint64_t seen = 0;
+            for (size_t b = 0; b < NB_BUCKETS; b++) {
+                seen += histogram[b];
+                if (seen >= rank) {
+                    return b == 0 ? 0 : (b == 63 ? UINT64_MAX : (std::uint64_t(1) << b) - 1);
+                }
+            }
+            return UINT64_MAX;
+        }
+    };
+
+    /**
+     * A point-in-time copy of every phase of a Stats object.
+     */
+    struct StatsReport {
+        std::vector<PhaseReport> phases;
+
+        /**
+         * @throws std::invalid_argument if there is no phase called name
+         */
+        const PhaseReport &operator[](const std::string &name) const {
+            for (auto &phase : phases) {
+                if (phase.name == name) {
+                    return phase;
+                }
+            }
+            throw std::invalid_argument("No such phase: " + name);
+        }
+
+        /**
+         * @brief Writes the report as one JSON object, keyed by phase name.
+         */
+        void dump(std::ostream &out) const {
+            out << "{";
+            for (size_t i = 0; i < phases.size(); i++) {
+                auto &phase = phases[i];
+                out << (i == 0 ? "" : ", ") << "\"" << phase.name << "\": {"
+                    << "\"calls\": " << phase.calls
+                    << ", \"total_ns\": " << phase.total_ns
+                    << ", \"mean_ns\": " << phase.mean_ns()
+                    << ", \"p50_ns\": " << phase.percentile_ns(50)
+                    << ", \"p99_ns\": " << phase.percentile_ns(99)
+                    << ", \"histogram\": [";
+
+                // trailing empty buckets carry no information
+                size_t last = PhaseReport::NB_BUCKETS;
+                while (last > 0 && phase.histogram[last - 1] == 0) {
+                    last--;
+                }
+                for (size_t b = 0; b < last; b++) {
+                    out << (b == 0 ? "" : ", ") << phase.histogram[b];
+                }
+                out << "]}";
+            }
+            out << "}";
+        }
+    };
+
+    /**
+     * Per-phase counters and latency histograms for a hot path. Every thread records
+     * into its own block of counters, found through a thread-local lookup, so recording
+     * never takes a lock or shares a cache line with another thread; report() sums the
+     * blocks. Recording compiles to nothing unless RACHEAL_ENABLE_STATS is defined;
+     * without it, reports are all zeros.
+     */
+    class Stats {
+    public:
+        /**
+         * @param phase_names one name per phase, phases are recorded by their index
+         */
+        explicit Stats(std::vector<std::string> phase_names)
+            : names(std::move(phase_names)), id(next_id().fetch_add(1, std::memory_order_relaxed)) {}
+
+        Stats(const Stats &) = delete;
+        Stats &operator=(const Stats &) = delete;
+
+        /**
+         * @brief Whether this build records anything at all.
+         */
+        static constexpr bool enabled() {
+#ifdef RACHEAL_ENABLE_STATS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * @brief Counts one call of a phase that took the given time.
+         */
+        void record(size_t phase, std::uint64_t nanoseconds) {
+#ifdef RACHEAL_ENABLE_STATS
+            auto &counters = local_block()[phase];
+            counters.calls.fetch_add(1, std::memory_order_relaxed);
+            counters.total_ns.fetch_add(nanoseconds, std::memory_order_relaxed);
+            size_t bucket = nanoseconds == 0 ? 0 : 64 - __builtin_clzll(nanoseconds);
+            counters.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+#else
+            (void) phase;
+            (void) nanoseconds;
+#endif
+        }
+
+        /**
+         * @brief Merges the counters of every thread. Calls still running on other
+         *        threads may or may not be included.
+         */
+        StatsReport report() const {
+            StatsReport report;
+            report.phases.resize(names.size());
+            for (size_t p = 0; p < names.size(); p++) {
+                report.phases[p].name = names[p];
+            }
+
+            std::lock_guard<std::mutex> guard(blocks_lock);
+            for (auto &block : blocks) {
+                for (size_t p = 0; p < names.size(); p++) {
+                    auto &phase = report.phases[p];
+                    phase.calls += block[p].calls.load(std::memory_order_relaxed);
+                    phase.total_ns += block[p].total_ns.load(std::memory_order_relaxed);
+                    for (size_t b = 0; b < PhaseReport::NB_BUCKETS; b++) {
+                        phase.histogram[b] += block[p].histogram[b].load(std::memory_order_relaxed);
+                    }
+                }
+            }
+            return report;
+        }
+
+        /**
+         * @brief Zeroes every counter, e.g. after a warm-up.
+         */
+        void reset() {
+            std::lock_guard<std::mutex> guard(blocks_lock);
+            for (auto &block : blocks) {
+                for (size_t p = 0; p < names.size(); p++) {
+                    block[p].calls.store(0, std::memory_order_relaxed);
+                    block[p].total_ns.store(0, std::memory_order_relaxed);
+                    for (auto &bucket : block[p].histogram) {
+                        bucket.store(0, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+
+        /**
+         * Times the enclosing scope as one call of a phase.
+         */
+        class Timer {
+        public:
+            Timer(Stats &stats, size_t phase)
+                : stats(stats), phase(phase), start(std::chrono::steady_clock::now()) {}
+
+            ~Timer() {
+                auto elapsed = std::chrono::steady_clock::now() - start;
+                stats.record(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            }
+
+            Timer(const Timer &) = delete;
+            Timer &operator=(const Timer &) = delete;
+
+        private:
+            Stats &stats;
+            size_t phase;
+            std::chrono::steady_clock::time_point start;
+        };
+
+    private:
+        // a cache line each, so neighbouring phases don't bounce between cores either
+        struct alignas(64) Counters {
+            std::atomic<std::uint64_t> calls{0};
+            std::atomic<std::uint64_t> total_ns{0};
+            std::array<std::atomic<std::uint64_t>, PhaseReport::NB_BUCKETS> histogram{};
+        };
+
+        // a block this thread records into, expired once its Stats object is gone
+        struct LocalBlock {
+            std::weak_ptr<const bool> owner;
+            Counters *counters;
+        };
+
+        static std::atomic<std::uint64_t> &next_id() {
+            static std::atomic<std::uint64_t> id{0};
+            return id;
+        }
+
+        // this thread's blocks by the id of the Stats object they belong to; ids are
+        // never reused, so entries left behind by destroyed objects never match
+        Counters *local_block() {
+            thread_local std::unordered_map<std::uint64_t, LocalBlock> local;
+            thread_local size_t prune_at = MIN_PRUNE;
+            auto found = local.find(id);
+            if (found != local.end()) {
+                return found->second.counters;
+            }
+
+            // first call on this thread for this object, the only time the lock is taken
+            Counters *counters;
+            {
+                std::lock_guard<std::mutex> guard(blocks_lock);
+                blocks.emplace_back(new Counters[names.size()]);
+                counters = blocks.back().get();
+            }
+
+            // threads that see many short-lived objects drop the entries of dead ones
+            // now and then, so the lookup grows with the live objects only
+            if (local.size() >= prune_at) {
+                for (auto entry = local.begin(); entry != local.end();) {
+                    entry = entry->second.owner.expired() ? local.erase(entry) : std::next(entry);
+                }
+                prune_at = std::max(MIN_PRUNE, 2 * local.size());
+            }
+            local.emplace(id, LocalBlock{alive, counters});
+            return counters;
+        }
+
+        static constexpr size_t MIN_PRUNE = 64;
+
+        std::vector<std::string> names;
+        std::uint64_t id;
+
+        // what the thread-local entries watch to tell that this object is gone
+        std::shared_ptr<const bool> alive = std::make_shared<const bool>(true);
+
+        mutable std::mutex blocks_lock;
+        std::vector<std::unique_ptr<Counters[]>> blocks;
+    };
+} // namespace che_utils
+
+// times the rest of the enclosing scope as one call of phase, nothing when stats are compiled out
+#ifdef RACHEAL_ENABLE_STATS
+#define RACHEAL_STATS_CONCAT_(a, b) a##b
+#define RACHEAL_STATS_CONCAT(a, b) RACHEAL_STATS_CONCAT_(a, b)
+#define RACHEAL_STATS_TIMER(stats, phase) \
+    che_utils::Stats::Timer RACHEAL_STATS_CONCAT(stats_timer_, __LINE__)((stats), (phase))
+#else
+#define RACHEAL_STATS_TIMER(stats, phase) ((void) 0)
+#endif
+
+#endif
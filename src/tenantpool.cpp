@@ -0,0 +1,101 @@
+#include "tenantpool.h"
+
+using namespace seal;
+using namespace che_utils;
+
+namespace racheal {
+    TenantPool::TenantPool(const EncryptionParameters &params, size_t memory_budget, 
+                           size_t init_cache_size, uint32_t radix) {
+        context_ = std::make_shared<const SEALContext>(params);
+        this->memory_budget = memory_budget;
+        this->init_cache_size = init_cache_size;
+        this->radix = radix;
+    }
+
+    std::shared_ptr<Rache> TenantPool::get(const std::string &tenant) {
+        std::promise<std::shared_ptr<Rache>> promise;
+        uint64_t id;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auto found = entries.find(tenant);
+            if (found != entries.end()) {
+                recent.splice(recent.begin(), recent, found->second.recent);
+
+                // may still be building on another thread, wait without the lock
+                auto rache = found->second.rache;
+                guard.unlock();
+                return rache.get();
+            }
+
+            // claim the tenant before building, so nobody else builds it too
+            recent.push_front(tenant);
+            id = next_id++;
+            entries[tenant] = Entry { promise.get_future().share(), recent.begin(), 0, id };
+        }
+
+        try {
+            auto rache = std::make_shared<Rache>(keys_for(tenant), init_cache_size, radix);
+            promise.set_value(rache);
+
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = entries.find(tenant);
+            if (found != entries.end() && found->second.id == id) {
+                found->second.bytes = rache->memory_usage();
+                used += found->second.bytes;
+                evict_locked();
+            }
+            return rache;
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = entries.find(tenant);
+            if (found != entries.end() && found->second.id == id) {
+                recent.erase(found->second.recent);
+                entries.erase(found);
+            }
+            throw;
+        }
+    }
+
+    std::shared_ptr<const KeyContext> TenantPool::keys_for(const std::string &tenant) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = tenant_keys.find(tenant);
+            if (found != tenant_keys.end()) {
+                return found->second;
+            }
+        }
+
+        // made outside the lock, since they take a while; a build still running from
+        // before an eviction may race us here, whichever keys land first win
+        auto keys = std::make_shared<const KeyContext>(context_);
+        std::lock_guard<std::mutex> guard(lock);
+        return tenant_keys.emplace(tenant, keys).first->second;
+    }
+
+    void TenantPool::evict_locked() {
+        while (used > memory_budget && recent.size() > 1) {
+            auto victim = entries.find(recent.back());
+            used -= victim->second.bytes;
+            recent.pop_back();
+            entries.erase(victim);
+            evicted++;
+        }
+    }
+
+    size_t TenantPool::size() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return entries.size();
+    }
+
+    size_t TenantPool::memory_usage() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return used;
+    }
+
+    size_t TenantPool::evictions() const {
+        std::lock_guard<std::mutex> guard(lock);
+        return evicted;
+    }
+} // namespace racheal
@@ -0,0 +1,100 @@
+#ifndef TENANTPOOL_H
+#define TENANTPOOL_H
+
+#include <stddef.h>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "seal/seal.h"
+#include "racheal.h"
+
+namespace racheal {
+    /**
+     * Hands out one Rache object per tenant. Every tenant gets its own keys and radix
+     * cache, but all of them share a single SEALContext, so the NTT tables exist once.
+     * When the radix caches take more memory than the budget, the least recently used
+     * tenants' Rache objects are dropped; anyone still holding one keeps it alive until
+     * they let go. A tenant's keys are kept for the lifetime of the pool, so ciphertexts
+     * made before an eviction still decrypt with the object rebuilt afterwards.
+     */
+    class TenantPool {
+    public:
+        /**
+         * @brief Construct a new, empty tenant pool.
+         * 
+         * @param params the encryption parameters shared by every tenant
+         * @param memory_budget the most bytes of radix caches to keep around, keys not included
+         * @param init_cache_size the initial cache size of each tenant's Rache (default 10)
+         * @param radix the radix of each tenant's Rache (default 2)
+         */
+        TenantPool(const seal::EncryptionParameters &params, size_t memory_budget, 
+                   size_t init_cache_size = 10, uint32_t radix = 2);
+
+        /**
+         * @brief Returns the tenant's Rache object, building it on first use or after it
+         *        was evicted. Keys are generated the first time a tenant is seen and reused
+         *        from then on. Concurrent calls for the same tenant wait on a single build.
+         * 
+         * @param tenant the tenant identifier
+         */
+        std::shared_ptr<Rache> get(const std::string &tenant);
+
+        /**
+         * @brief Number of tenants currently cached.
+         */
+        size_t size() const;
+
+        /**
+         * @brief Bytes of radix caches currently accounted to cached tenants.
+         */
+        size_t memory_usage() const;
+
+        /**
+         * @brief Number of tenants dropped to stay within the budget so far.
+         */
+        size_t evictions() const;
+
+        /**
+         * @brief The context shared by every tenant.
+         */
+        std::shared_ptr<const seal::SEALContext> context() const {
+            return context_;
+        }
+
+    private:
+        struct Entry {
+            std::shared_future<std::shared_ptr<Rache>> rache;
+            std::list<std::string>::iterator recent;
+            size_t bytes;
+            uint64_t id;
+        };
+
+        // drops least recently used tenants until within budget, keeping the newest one
+        void evict_locked();
+
+        // the tenant's keys, generated on first use and never dropped
+        std::shared_ptr<const che_utils::KeyContext> keys_for(const std::string &tenant);
+
+        std::shared_ptr<const seal::SEALContext> context_;
+        size_t memory_budget;
+        size_t init_cache_size;
+        uint32_t radix;
+
+        mutable std::mutex lock;
+
+        // most recently used tenant first
+        std::list<std::string> recent;
+        std::unordered_map<std::string, Entry> entries;
+
+        // every tenant ever seen, evictions only drop entries
+        std::unordered_map<std::string, std::shared_ptr<const che_utils::KeyContext>> tenant_keys;
+        size_t used = 0;
+        size_t evicted = 0;
+        uint64_t next_id = 0;
+    };
+} // namespace racheal
+
+#endif
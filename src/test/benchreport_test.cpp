@@ -0,0 +1,87 @@
+#include "gtest/gtest.h"
+#include "benchreport.h"
+#include <sstream>
+#include <string>
+
+using namespace che_utils;
+
+namespace benchreporttest {
+    BenchReport sample_report() {
+        BenchReport report;
+        report.config = {{"engine", "\"rache\""}, {"degree", "8192"}, {"memo", "0"}};
+        report.results["encrypt"] = {12.5, 12, 30.25, 80000};
+        report.results["setup"] = {1.5e6, 1.5e6, 1.5e6, 0.666667};
+
+        PhaseReport phase;
+        phase.name = "assemble";
+        phase.calls = 3;
+        phase.total_ns = 700;
+        phase.histogram[7] = 2;
+        phase.histogram[9] = 1;
+        report.phases.phases.push_back(phase);
+
+        report.compared = true;
+        report.comparison["encrypt"] = {10, 0.25, true};
+        return report;
+    }
+
+    std::string to_json(const BenchReport &report) {
+        std::stringstream out;
+        write_bench_report(out, report);
+        return out.str();
+    }
+
+    // whatever the runner writes reads back to the same values and the same text
+    TEST(BenchReportTest, RoundTrips) {
+        std::string json = to_json(sample_report());
+        BenchReport report = read_bench_report(json);
+
+        ASSERT_EQ(report.config.size(), 3u);
+        EXPECT_EQ(report.config[0].first, "engine");
+        EXPECT_EQ(report.config[0].second, "\"rache\"");
+        EXPECT_EQ(report.config[1].second, "8192");
+
+        ASSERT_EQ(report.results.size(), 2u);
+        EXPECT_DOUBLE_EQ(report.results["encrypt"].mean_us, 12.5);
+        EXPECT_DOUBLE_EQ(report.results["encrypt"].p99_us, 30.25);
+        EXPECT_DOUBLE_EQ(report.results["setup"].mean_us, 1.5e6);
+
+        ASSERT_EQ(report.phases.phases.size(), 1u);
+        EXPECT_EQ(report.phases["assemble"].calls, 3u);
+        EXPECT_EQ(report.phases["assemble"].histogram[9], 1u);
+
+        EXPECT_TRUE(report.compared);
+        EXPECT_TRUE(report.comparison["encrypt"].regressed);
+        EXPECT_DOUBLE_EQ(report.comparison["encrypt"].change, 0.25);
+
+        EXPECT_EQ(to_json(report), json);
+
+        // the optional sections can be left out
+        BenchReport bare = sample_report();
+        bare.phases.phases.clear();
+        bare.compared = false;
+        bare.comparison.clear();
+        EXPECT_EQ(to_json(read_bench_report(to_json(bare))), to_json(bare));
+    }
+
+    // anything the runner wouldn't have written is refused, not guessed at
+    TEST(BenchReportTest, RejectsOtherDocuments) {
+        std::string json = to_json(sample_report());
+
+        EXPECT_THROW(read_bench_report(""), std::invalid_argument);
+        EXPECT_THROW(read_bench_report(json.substr(0, json.size() / 2)), std::invalid_argument);
+        EXPECT_THROW(read_bench_report(json + "{}"), std::invalid_argument);
+        EXPECT_THROW(read_bench_report("{\"results\": {}}"), std::invalid_argument);
+
+        auto replaced = [&](const std::string &from, const std::string &to) {
+            std::string bad = json;
+            bad.replace(bad.find(from), from.size(), to);
+            return bad;
+        };
+        EXPECT_THROW(read_bench_report(replaced("\"mean_us\": 12.5", "\"mean_us\": \"12.5\"")), std::invalid_argument);
+        EXPECT_THROW(read_bench_report(replaced("\"p50_us\"", "\"median_us\"")), std::invalid_argument);
+        EXPECT_THROW(read_bench_report(replaced("\"regressed\": true", "\"regressed\": 1")), std::invalid_argument);
+        EXPECT_THROW(read_bench_report(replaced("\"phases\"", "\"timings\"")), std::invalid_argument);
+        EXPECT_THROW(read_bench_report(replaced("\"setup\"", "\"encrypt\"")), std::invalid_argument);
+    }
+} // namespace benchreporttest
@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+#include "columnfile.h"
+#include "inche.h"
+#include "utils.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace inche;
+using namespace che_utils;
+
+namespace columnfiletest {
+    // every row reads back to the ciphertext that was appended, in any order
+    TEST(ColumnFileTest, ReadsRowsBack) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        auto context = inche.key_context()->shared_context();
+        std::string path = testing::TempDir() + "column_test_file";
+
+        for (auto compr_mode : {seal::compr_mode_type::none, seal::Serialization::compr_mode_default}) {
+            // a batch size that doesn't divide the row count leaves a partial last batch
+            std::vector<double> values;
+            {
+                ColumnWriter writer(path, compr_mode, 3);
+                seal::Ciphertext ctxt;
+                for (int i = 0; i < 10; i++) {
+                    values.push_back(i * 11);
+                    inche.encrypt(values.back(), ctxt);
+                    writer.append(ctxt);
+                }
+                EXPECT_EQ(writer.rows(), values.size());
+                writer.close();
+            }
+
+            ColumnReader reader(path, context);
+            ASSERT_EQ(reader.rows(), values.size());
+            for (size_t row : {7, 0, 9, 3}) {
+                seal::Ciphertext ctxt;
+                seal::Plaintext plain;
+                reader.read(row, ctxt);
+                inche.decrypt(ctxt, plain);
+                EXPECT_EQ(plain.to_string(), uint64_to_hex_string(values[row]));
+            }
+
+            seal::Ciphertext ctxt;
+            EXPECT_THROW(reader.read(values.size(), ctxt), std::out_of_range);
+        }
+
+        std::remove(path.c_str());
+    }
+
+    // the caller's ciphertext is copied into the batch, so it can be encrypted into
+    // again right away, the way the dataset runner reuses one for every row
+    TEST(ColumnFileTest, AppendsReusedCiphertext) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        auto context = inche.key_context()->shared_context();
+        std::string path = testing::TempDir() + "column_test_file";
+
+        seal::Ciphertext ctxt;
+        seal::Plaintext plain;
+        {
+            ColumnWriter writer(path, seal::compr_mode_type::none, 2);
+            for (int i = 0; i < 5; i++) {
+                inche.encrypt(i + 1, ctxt);
+                writer.append(ctxt);
+                inche.decrypt(ctxt, plain);
+                EXPECT_EQ(plain.to_string(), uint64_to_hex_string(i + 1));
+            }
+            writer.close();
+        }
+
+        ColumnReader reader(path, context);
+        ASSERT_EQ(reader.rows(), 5);
+        for (size_t row = 0; row < reader.rows(); row++) {
+            reader.read(row, ctxt);
+            inche.decrypt(ctxt, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(row + 1));
+        }
+        std::remove(path.c_str());
+    }
+
+    // an empty column is still a valid file, a file that was never closed is not
+    TEST(ColumnFileTest, RejectsUnfinishedFiles) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        auto context = inche.key_context()->shared_context();
+        std::string path = testing::TempDir() + "column_test_file";
+
+        ColumnWriter(path, seal::compr_mode_type::none).close();
+        EXPECT_EQ(ColumnReader(path, context).rows(), 0);
+
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::app);
+            out << "trailing garbage";
+        }
+        EXPECT_THROW(ColumnReader(path, context), std::invalid_argument);
+        std::remove(path.c_str());
+    }
+
+    // a row index that runs backwards or past its own start is refused up front
+    TEST(ColumnFileTest, RejectsCorruptIndex) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        auto context = inche.key_context()->shared_context();
+        std::string path = testing::TempDir() + "column_test_file";
+
+        {
+            ColumnWriter writer(path, seal::compr_mode_type::none);
+            seal::Ciphertext ctxt;
+            for (int i = 0; i < 3; i++) {
+                inche.encrypt(i, ctxt);
+                writer.append(ctxt);
+            }
+            writer.close();
+        }
+
+        std::string original;
+        {
+            std::ifstream in(path, std::ios::binary);
+            original.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        // the index holds rows + 1 offsets and sits right before the 24 byte trailer
+        size_t index_start = original.size() - 24 - 4 * sizeof(uint64_t);
+        auto corrupt = [&](size_t entry, uint64_t value) {
+            std::string bytes = original;
+            std::memcpy(&bytes[index_start + entry * sizeof(uint64_t)], &value, sizeof(value));
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), bytes.size());
+        };
+
+        corrupt(2, 0);
+        EXPECT_THROW(ColumnReader(path, context), std::invalid_argument);
+        corrupt(3, index_start + 1);
+        EXPECT_THROW(ColumnReader(path, context), std::invalid_argument);
+        corrupt(0, 0);
+        EXPECT_THROW(ColumnReader(path, context), std::invalid_argument);
+
+        // the last offset is where the index starts, writing it back restores the file
+        corrupt(3, index_start);
+        EXPECT_EQ(ColumnReader(path, context).rows(), 3);
+        std::remove(path.c_str());
+    }
+} // namespace columnfiletest
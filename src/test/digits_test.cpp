@@ -0,0 +1,59 @@
+#include "gtest/gtest.h"
+#include "digits.h"
+#include <cstdint>
+#include <vector>
+
+using namespace che_utils;
+
+namespace digitstest {
+    // the value the digits stand for, so every kernel can be checked the same way
+    int64_t compose(const std::vector<int32_t> &digits, uint32_t radix) {
+        int64_t value = 0;
+        for (size_t k = digits.size(); k-- > 0;) {
+            value = value * radix + digits[k];
+        }
+        return value;
+    }
+
+    // every kernel (compile-time, shift and runtime radices) splits into digits that compose back
+    TEST(DigitsTest, SplitsEveryRadix) {
+        std::vector<int32_t> digits;
+        for (uint32_t radix : {2, 3, 4, 7, 8, 10, 16, 32, 1000}) {
+            DigitSplitter splitter(radix);
+            for (uint64_t v : {0ull, 1ull, 9ull, 1000ull, 65535ull, 123456789ull, (1ull << 53) - 1}) {
+                splitter.split(v, digits);
+                EXPECT_EQ(digits.size(), splitter.digit_count(v));
+                EXPECT_EQ(compose(digits, radix), (int64_t) v);
+                for (auto d : digits) {
+                    EXPECT_GE(d, 0);
+                    EXPECT_LT(d, (int32_t) radix);
+                }
+
+                splitter.split_balanced(v, digits);
+                EXPECT_EQ(compose(digits, radix), (int64_t) v);
+                for (auto d : digits) {
+                    EXPECT_GT(d, -(int32_t) radix / 2 - 1);
+                    EXPECT_LE(d, (int32_t) radix / 2);
+                }
+            }
+        }
+    }
+
+    // exact powers, where floor(log(v) / log(r)) tends to come out one short
+    TEST(DigitsTest, CountsExactPowers) {
+        std::vector<int32_t> digits;
+        DigitSplitter splitter(10);
+        uint64_t power = 1;
+        for (size_t k = 0; k <= 19; k++) {
+            EXPECT_EQ(splitter.digit_count(power), k + 1);
+            EXPECT_EQ(splitter.digit_count(power - 1), k);
+            EXPECT_EQ(splitter.max_value(k), power - 1);
+            splitter.split(power, digits);
+            ASSERT_EQ(digits.size(), k + 1);
+            EXPECT_EQ(digits.back(), 1);
+            power *= 10;
+        }
+        EXPECT_EQ(splitter.max_value(20), UINT64_MAX);
+        EXPECT_THROW(DigitSplitter(1), std::invalid_argument);
+    }
+} // namespace digitstest
@@ -0,0 +1,29 @@
+#include "gtest/gtest.h"
+#include "hugepages.h"
+
+using namespace che_utils;
+
+namespace hugepagestest {
+    // every mode hands out zeroed, writable memory of at least the requested size
+    TEST(HugePagesTest, MapsWritableMemory) {
+        for (auto mode : {huge_pages::none, huge_pages::transparent, huge_pages::hugetlb}) {
+            size_t bytes = 3 * HugePageBuffer::HUGE_PAGE_SIZE + 123;
+            HugePageBuffer buffer(bytes, mode);
+            ASSERT_GE(buffer.size(), bytes);
+
+            size_t count = bytes / sizeof(uint64_t);
+            for (size_t i = 0; i < count; i++) {
+                EXPECT_EQ(buffer.data()[i], 0u);
+                buffer.data()[i] = i;
+            }
+            EXPECT_EQ(buffer.data()[count - 1], count - 1);
+        }
+    }
+
+    // huge pages only back ranges that start on a huge page boundary
+    TEST(HugePagesTest, AlignsToHugePages) {
+        HugePageBuffer buffer(100, huge_pages::transparent);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer.data()) % HugePageBuffer::HUGE_PAGE_SIZE, 0u);
+        EXPECT_EQ(buffer.size(), HugePageBuffer::HUGE_PAGE_SIZE);
+    }
+} // namespace hugepagestest
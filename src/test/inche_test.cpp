@@ -0,0 +1,138 @@
+#include "gtest/gtest.h"
+#include "inche.h"
+#include "utils.h"
+
+using namespace inche;
+using namespace che_utils;
+
+namespace inchetest {
+    // tests that BFV encryptions decrypt back to the original value
+    TEST(IncheEncryptionTest, DecryptsBFVValues) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        seal::Ciphertext destination;
+        for (uint64_t value : {0, 1, 100, 5000}) {
+            seal::Plaintext plain;
+            inche.encrypt(value, destination);
+            inche.decrypt(destination, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+        }
+    }
+
+    // test that batch encryption decrypts to the same values, in order
+    TEST(IncheEncryptionTest, EncryptsBatches) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        std::vector<double> values = {0, 3, 17, 255, 1024, 9, 42, 7};
+        std::vector<seal::Ciphertext> destination;
+        EXPECT_NO_THROW(inche.encrypt_batch(values, destination));
+        ASSERT_EQ(destination.size(), values.size());
+
+        for (size_t i = 0; i < values.size(); i++) {
+            seal::Plaintext plain;
+            inche.decrypt(destination[i], plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(values[i]));
+        }
+    }
+
+    // test that noise from the background producers decrypts the same way
+    TEST(IncheEncryptionTest, UsesNoiseProducers) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        inche.start_noise_producers(2, 8);
+
+        std::vector<double> values(64);
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = i * 37;
+        }
+
+        std::vector<seal::Ciphertext> destination;
+        inche.encrypt_batch(values, destination);
+        inche.stop_noise_producers();
+
+        for (size_t i = 0; i < values.size(); i++) {
+            seal::Plaintext plain;
+            inche.decrypt(destination[i], plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(values[i]));
+        }
+    }
+
+    // test that packed CKKS values land in their own slots
+    TEST(IncheEncryptionTest, PacksSlots) {
+        Inche inche(seal::scheme_type::ckks, 8192);
+        EXPECT_EQ(inche.slot_count(), 4096);
+
+        std::vector<double> values(1000);
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = i * 0.5;
+        }
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        std::vector<double> decoded;
+        inche.encrypt(values, destination);
+        inche.decrypt(destination, plain);
+        seal::CKKSEncoder(inche.key_context()->context()).decode(plain, decoded);
+        for (size_t i = 0; i < values.size(); i++) {
+            EXPECT_NEAR(decoded[i], values[i], 0.01);
+        }
+        EXPECT_NEAR(decoded[values.size()], 0, 0.01);
+    }
+
+    // test that packed BFV integers land in their own slots
+    TEST(IncheEncryptionTest, PacksIntegers) {
+        Inche inche(seal::scheme_type::bfv, 8192);
+        EXPECT_EQ(inche.slot_count(), 8192);
+
+        std::vector<uint64_t> values(inche.slot_count());
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = i * 101;
+        }
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        std::vector<uint64_t> decoded;
+        inche.encrypt(values, destination);
+        inche.decrypt(destination, plain);
+        seal::BatchEncoder(inche.key_context()->context()).decode(plain, decoded);
+        EXPECT_EQ(decoded, values);
+    }
+
+    // test that inline noise is counted as sampling and NTT, pooled noise as neither
+    TEST(IncheEncryptionTest, RecordsPhases) {
+        if (!Stats::enabled()) {
+            GTEST_SKIP() << "built without RACHEAL_ENABLE_STATS";
+        }
+
+        Inche inche(seal::scheme_type::ckks, 8192);
+        seal::Ciphertext destination;
+        inche.encrypt(42, destination);
+
+        auto stats = inche.stats();
+        EXPECT_EQ(stats["encode"].calls, 1u);
+        EXPECT_EQ(stats["sample_noise"].calls, destination.size());
+        EXPECT_EQ(stats["ntt"].calls, destination.size());
+        EXPECT_EQ(stats["poly_add"].calls, destination.size());
+    }
+
+    // test that per-thread pools and huge pages decrypt the same way
+    TEST(IncheEncryptionTest, UsesThreadLocalPools) {
+        Inche inche(seal::scheme_type::ckks, 8192);
+        inche.use_thread_local_pools();
+        inche.set_huge_pages(huge_pages::transparent);
+        inche.start_noise_producers(1, 8);
+
+        std::vector<double> values(64, 1234);
+        std::vector<seal::Ciphertext> destination;
+        inche.encrypt_batch(values, destination);
+        inche.stop_noise_producers();
+
+        seal::CKKSEncoder encoder(inche.key_context()->context());
+        for (auto &ctxt : destination) {
+            seal::Plaintext plain;
+            std::vector<double> decoded;
+            inche.decrypt(ctxt, plain);
+            encoder.decode(plain, decoded);
+            EXPECT_NEAR(decoded[0], 1234, 0.5);
+        }
+
+        EXPECT_THROW(inche.set_memory_pool(seal::MemoryPoolHandle()), std::invalid_argument);
+    }
+} // namespace inchetest
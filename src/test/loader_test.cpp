@@ -0,0 +1,57 @@
+#include "gtest/gtest.h"
+#include "loader.h"
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+using namespace che_utils;
+
+namespace loadertest {
+    std::string write_dataset(const std::string &contents) {
+        std::string path = testing::TempDir() + "loader_test_dataset";
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << contents;
+        return path;
+    }
+
+    // chunks of every size give back every value in order, also when split across threads
+    TEST(DatasetReaderTest, ReadsInChunks) {
+        std::mt19937 gen(7);
+        std::vector<double> expected;
+        std::string contents;
+        for (int i = 0; i < 20000; i++) {
+            expected.push_back(gen() % 100000 / 8.0);
+            contents += std::to_string(expected.back()) + "\n";
+        }
+        std::string path = write_dataset(contents);
+
+        for (size_t chunk_bytes : {1, 7, 4096, 1 << 20}) {
+            DatasetReader reader(path, chunk_bytes);
+            std::vector<double> values, chunk;
+            while (reader.next(chunk)) {
+                values.insert(values.end(), chunk.begin(), chunk.end());
+            }
+            EXPECT_EQ(values, expected);
+            EXPECT_EQ(reader.values_read(), expected.size());
+        }
+
+        EXPECT_EQ(DatasetReader::read_all(path), expected);
+        std::remove(path.c_str());
+    }
+
+    // blank lines, Windows line endings and a missing final newline are all fine
+    TEST(DatasetReaderTest, ToleratesFormatting) {
+        std::string path = write_dataset("1\r\n\n  2.5\n+3\n-4e2\n\n1206092.751");
+        std::vector<double> expected = {1, 2.5, 3, -400, 1206092.751};
+        EXPECT_EQ(DatasetReader::read_all(path), expected);
+        std::remove(path.c_str());
+    }
+
+    TEST(DatasetReaderTest, RejectsBadLines) {
+        std::string path = write_dataset("1\n2\nthree\n4\n");
+        EXPECT_THROW(DatasetReader::read_all(path), std::invalid_argument);
+        std::remove(path.c_str());
+
+        EXPECT_THROW(DatasetReader("/nonexistent/dataset"), std::runtime_error);
+    }
+} // namespace loadertest
@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+#include "lrucache.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace che_utils;
+
+namespace lrucachetest {
+    // the least recently used entry goes first, and every lookup is counted
+    TEST(LruCacheTest, EvictsLeastRecentlyUsed) {
+        LruCache<int, int> cache(2, 1);
+        cache.put(1, std::make_shared<const int>(10));
+        cache.put(2, std::make_shared<const int>(20));
+        ASSERT_NE(cache.get(1), nullptr);
+        cache.put(3, std::make_shared<const int>(30));
+
+        EXPECT_EQ(*cache.get(1), 10);
+        EXPECT_EQ(cache.get(2), nullptr);
+        EXPECT_EQ(*cache.get(3), 30);
+
+        // replacing keeps the size
+        cache.put(3, std::make_shared<const int>(31));
+        EXPECT_EQ(*cache.get(3), 31);
+
+        auto stats = cache.stats();
+        EXPECT_EQ(stats.hits, 4u);
+        EXPECT_EQ(stats.misses, 1u);
+        EXPECT_EQ(stats.evictions, 1u);
+        EXPECT_EQ(stats.size, 2u);
+        EXPECT_DOUBLE_EQ(stats.hit_rate(), 0.8);
+    }
+
+    // values handed out stay valid after they are evicted
+    TEST(LruCacheTest, KeepsEvictedValuesAlive) {
+        LruCache<int, std::vector<int>> cache(1, 1);
+        cache.put(1, std::make_shared<const std::vector<int>>(100, 1));
+        auto held = cache.get(1);
+        cache.put(2, std::make_shared<const std::vector<int>>(100, 2));
+        EXPECT_EQ(cache.get(1), nullptr);
+        EXPECT_EQ(held->size(), 100u);
+    }
+
+    // many threads hitting a few hot keys, the shards never exceed the capacity
+    TEST(LruCacheTest, SharesBetweenThreads) {
+        LruCache<uint64_t, uint64_t> cache(64, 8);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 8; t++) {
+            threads.emplace_back([&cache, t] {
+                for (uint64_t i = 0; i < 10000; i++) {
+                    uint64_t key = (i * 7 + t) % 100;
+                    auto value = cache.get(key);
+                    if (value == nullptr) {
+                        cache.put(key, std::make_shared<const uint64_t>(key * 2));
+                    } else {
+                        ASSERT_EQ(*value, key * 2);
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        auto stats = cache.stats();
+        EXPECT_EQ(stats.hits + stats.misses, 80000u);
+        EXPECT_LE(stats.size, cache.capacity());
+        EXPECT_GT(stats.hits, 0u);
+    }
+} // namespace lrucachetest
@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+#include "polyadd.h"
+#include <random>
+#include <vector>
+
+using namespace seal;
+using namespace che_utils;
+
+namespace polyaddtest {
+    // straightforward modular sum of the same operands, one at a time
+    std::vector<uint64_t> reference(std::vector<uint64_t> destination,
+                                    const std::vector<std::vector<uint64_t>> &addends,
+                                    const std::vector<std::vector<uint64_t>> &subtrahends,
+                                    size_t coeff_count, const std::vector<Modulus> &coeff_modulus) {
+        for (size_t i = 0; i < coeff_modulus.size(); i++) {
+            unsigned __int128 q = coeff_modulus[i].value();
+            for (size_t c = i * coeff_count; c < (i + 1) * coeff_count; c++) {
+                unsigned __int128 acc = destination[c];
+                for (auto &addend : addends) {
+                    acc = (acc + addend[c]) % q;
+                }
+                for (auto &subtrahend : subtrahends) {
+                    acc = (acc + q - subtrahend[c]) % q;
+                }
+                destination[c] = acc;
+            }
+        }
+        return destination;
+    }
+
+    // enough operands to run out of headroom several times for the 60-bit modulus,
+    // and a degree that leaves a scalar tail after the vector loops
+    void check(size_t nb_addends, size_t nb_subtrahends) {
+        const size_t coeff_count = 37;
+        std::vector<Modulus> coeff_modulus = { Modulus(1152921504606584833ULL), Modulus(1099511480321ULL), Modulus(65537) };
+        size_t size = coeff_count * coeff_modulus.size();
+
+        std::mt19937_64 gen(nb_addends * 131 + nb_subtrahends);
+        auto random_poly = [&] {
+            std::vector<uint64_t> poly(size);
+            for (size_t c = 0; c < size; c++) {
+                uint64_t q = coeff_modulus[c / coeff_count].value();
+                // bias towards the top of the range, where lazy sums overflow first
+                poly[c] = gen() % 4 == 0 ? q - 1 : gen() % q;
+            }
+            return poly;
+        };
+
+        auto destination = random_poly();
+        std::vector<std::vector<uint64_t>> addends, subtrahends;
+        std::vector<const uint64_t *> add_ptrs, sub_ptrs;
+        for (size_t k = 0; k < nb_addends; k++) {
+            addends.push_back(random_poly());
+        }
+        for (size_t k = 0; k < nb_subtrahends; k++) {
+            subtrahends.push_back(random_poly());
+        }
+        for (auto &addend : addends) {
+            add_ptrs.push_back(addend.data());
+        }
+        for (auto &subtrahend : subtrahends) {
+            sub_ptrs.push_back(subtrahend.data());
+        }
+
+        auto expected = reference(destination, addends, subtrahends, coeff_count, coeff_modulus);
+        add_poly_multi(destination.data(), add_ptrs, sub_ptrs, coeff_count, coeff_modulus);
+        EXPECT_EQ(destination, expected);
+    }
+
+    TEST(PolyAddTest, AddsSinglePolynomial) {
+        check(1, 0);
+        check(0, 1);
+    }
+
+    TEST(PolyAddTest, AddsManyPolynomials) {
+        check(5, 3);
+        check(40, 0);
+        check(0, 40);
+        check(33, 17);
+    }
+
+    // repeated operands are how Rache adds a digit more than once
+    TEST(PolyAddTest, AcceptsRepeatedOperands) {
+        const size_t coeff_count = 8;
+        std::vector<Modulus> coeff_modulus = { Modulus(1152921504606584833ULL) };
+        uint64_t q = coeff_modulus[0].value();
+
+        std::vector<uint64_t> destination(coeff_count, 0), addend(coeff_count, q - 1);
+        std::vector<const uint64_t *> adds(20, addend.data());
+        add_poly_multi(destination.data(), adds, {}, coeff_count, coeff_modulus);
+        for (auto coeff : destination) {
+            EXPECT_EQ(coeff, q - 20);
+        }
+    }
+} // namespace polyaddtest
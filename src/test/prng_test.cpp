@@ -0,0 +1,40 @@
+#include "gtest/gtest.h"
+#include "prng.h"
+#include <set>
+
+using namespace che_utils;
+
+namespace prngtest {
+    // the same seed and stream give the same sequence, other streams don't
+    TEST(PrngTest, SeparatesStreams) {
+        Xoshiro256 a(42, 0), b(42, 0), c(42, 1);
+        std::set<uint64_t> seen;
+        for (int i = 0; i < 1000; i++) {
+            uint64_t x = a();
+            EXPECT_EQ(x, b());
+            EXPECT_NE(x, c());
+            seen.insert(x);
+        }
+        EXPECT_EQ(seen.size(), 1000u);
+    }
+
+    // coins come out about even and picks stay in range
+    TEST(PrngTest, FlipsAndPicks) {
+        Xoshiro256 rng(7, 3);
+        int heads = 0;
+        for (int i = 0; i < 100000; i++) {
+            heads += rng.coin();
+        }
+        EXPECT_NEAR(heads, 50000, 1000);
+
+        std::vector<int> counts(5);
+        for (int i = 0; i < 50000; i++) {
+            uint64_t pick = rng.below(5);
+            ASSERT_LT(pick, 5u);
+            counts[pick]++;
+        }
+        for (int count : counts) {
+            EXPECT_NEAR(count, 10000, 500);
+        }
+    }
+} // namespace prngtest
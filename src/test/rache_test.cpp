@@ -1,7 +1,14 @@
 #include "gtest/gtest.h"
 #include "racheal.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <thread>
 
 using namespace racheal;
+using namespace che_utils;
 
 namespace rachetest {
     // tests encryption of small values works without errors
@@ -28,6 +35,529 @@ namespace rachetest {
     TEST(RacheEncryptionTest, ThrowsExceptions) {
         Rache rache(seal::scheme_type::ckks);
         seal::Ciphertext destination;
+        EXPECT_THROW(rache.encrypt(1e300, destination), std::invalid_argument);
+
+        rache.set_growth(false);
         EXPECT_THROW(rache.encrypt(1024, destination), std::invalid_argument);
+        EXPECT_EQ(rache.growth_stats().rejected, 2);
+    }
+
+    // test that negative values are refused unless the digits are balanced, which negate them
+    TEST(RacheEncryptionTest, RejectsNegativeValues) {
+        seal::EncryptionParameters params(seal::scheme_type::ckks);
+        params.set_poly_modulus_degree(8192);
+        params.set_coeff_modulus(seal::CoeffModulus::BFVDefault(8192));
+        Rache rache(params);
+
+        seal::Ciphertext destination;
+        std::vector<seal::Ciphertext> batch;
+        EXPECT_THROW(rache.encrypt(-1, destination), std::invalid_argument);
+        EXPECT_THROW(rache.encrypt(-0.5, destination), std::invalid_argument);
+        EXPECT_THROW(rache.encrypt_batch({1, 2, -3}, batch), std::invalid_argument);
+        EXPECT_THROW(rache.encrypt(std::vector<double>{1, -2}, destination), std::invalid_argument);
+
+        rache.set_digit_mode(digit_mode::balanced);
+        seal::CKKSEncoder encoder(rache.key_context()->context());
+        seal::Plaintext plain;
+        std::vector<double> decoded;
+        for (double value : {-1.0, -7.0, -1000.5}) {
+            rache.encrypt(value, destination);
+            rache.decrypt(destination, plain);
+            encoder.decode(plain, decoded);
+            EXPECT_NEAR(decoded[0], std::trunc(value), 0.01);
+        }
+        EXPECT_THROW(rache.encrypt(-1e300, destination), std::invalid_argument);
+    }
+
+    // test that values past the cache grow it in the background, up to the cap
+    TEST(RacheEncryptionTest, GrowsCache) {
+        Rache rache(seal::scheme_type::bfv);
+        rache.precompute_windows(1 << 20);
+        EXPECT_EQ(rache.get_cache_size(), 10);
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        rache.encrypt(5000, destination);
+        rache.decrypt(destination, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(5000));
+        EXPECT_EQ(rache.get_cache_size(), 13);
+
+        auto growth = rache.growth_stats();
+        EXPECT_EQ(growth.events, 1);
+        EXPECT_EQ(growth.digits_added, 3);
+        EXPECT_EQ(growth.waits, 1);
+
+        // smaller values still compose, from the grown windows as well
+        for (double value : {0, 1, 1023, 8191}) {
+            rache.encrypt(value, destination);
+            rache.decrypt(destination, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+        }
+
+        // requested growth is there by the time a value needs it
+        rache.grow_cache(16);
+        rache.encrypt(65535, destination);
+        rache.decrypt(destination, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(65535));
+        EXPECT_EQ(rache.get_cache_size(), 16);
+
+        rache.set_growth(true, 18);
+        EXPECT_THROW(rache.grow_cache(19), std::invalid_argument);
+        EXPECT_THROW(rache.encrypt(1 << 18, destination), std::invalid_argument);
+    }
+
+    // test that batch encryption decrypts to the same values, in order
+    TEST(RacheEncryptionTest, EncryptsBatches) {
+        Rache rache(seal::scheme_type::bfv);
+        std::vector<double> values = {0, 1, 2, 7, 500, 1023, 64, 3};
+        std::vector<seal::Ciphertext> destination;
+        EXPECT_NO_THROW(rache.encrypt_batch(values, destination));
+        ASSERT_EQ(destination.size(), values.size());
+
+        for (size_t i = 0; i < values.size(); i++) {
+            seal::Plaintext plain;
+            rache.decrypt(destination[i], plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(values[i]));
+        }
+
+        // values out of range are still reported from inside the batch
+        rache.set_growth(false);
+        values.push_back(1024);
+        EXPECT_THROW(rache.encrypt_batch(values, destination), std::invalid_argument);
+    }
+
+    // test that exact powers of a radix other than 2 keep their leading digit
+    TEST(RacheEncryptionTest, ComposesExactPowers) {
+        Rache rache(seal::scheme_type::bfv, 6, 10);
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        for (double value : {1, 10, 1000, 100000, 999999}) {
+            rache.encrypt(value, destination);
+            rache.decrypt(destination, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+        }
+    }
+
+    // test that remembered values decrypt the same and are counted as hits
+    TEST(RacheEncryptionTest, RemembersValues) {
+        Rache rache(seal::scheme_type::bfv);
+        rache.precompute_randomizers(16);
+        rache.set_memo(4, 1);
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        std::vector<seal::Ciphertext> repeated;
+        for (int round = 0; round < 6; round++) {
+            for (double value : {0, 7, 500, 1023}) {
+                rache.encrypt(value, destination);
+                rache.decrypt(destination, plain);
+                EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+                if (value == 500) {
+                    repeated.push_back(destination);
+                }
+            }
+        }
+
+        auto memo = rache.memo_stats();
+        EXPECT_EQ(memo.misses, 4u);
+        EXPECT_EQ(memo.hits, 20u);
+        EXPECT_EQ(memo.size, 4u);
+
+        // every hit is randomized afresh, not handed out as is
+        size_t same = 0;
+        for (size_t i = 1; i < repeated.size(); i++) {
+            same += std::equal(repeated[0].data(), repeated[0].data() + 16, repeated[i].data());
+        }
+        EXPECT_LT(same, repeated.size() - 1);
+
+        // even with a pool of two, hits don't repeat ciphertexts, the zero sums are drawn anew
+        Rache small_pool(seal::scheme_type::bfv, 40);
+        small_pool.precompute_randomizers(2);
+        small_pool.set_memo(4, 1);
+        std::vector<seal::Ciphertext> hits(8);
+        for (auto &hit : hits) {
+            small_pool.encrypt(500, hit);
+        }
+        for (size_t i = 0; i < hits.size(); i++) {
+            for (size_t j = i + 1; j < hits.size(); j++) {
+                EXPECT_FALSE(std::equal(hits[i].data(), hits[i].data() + 16, hits[j].data()));
+            }
+        }
+
+        // a fifth value pushes out the least recently used one
+        rache.encrypt(3, destination);
+        EXPECT_EQ(rache.memo_stats().evictions, 1u);
+
+        rache.set_memo(0);
+        rache.encrypt(3, destination);
+        EXPECT_EQ(rache.memo_stats().hits, 0u);
+    }
+
+    // test that sampled noise budgets are counted and stay below a fresh encryption's
+    TEST(RacheEncryptionTest, SamplesNoiseBudget) {
+        Rache rache(seal::scheme_type::bfv);
+        EXPECT_EQ(rache.noise_stats().samples, 0u);
+        rache.set_noise_sampling(2);
+
+        seal::Ciphertext destination;
+        for (double value : {1, 7, 500, 1023, 64, 3}) {
+            rache.encrypt(value, destination);
+        }
+
+        auto noise = rache.noise_stats();
+        EXPECT_EQ(noise.samples, 3u);
+        EXPECT_GT(noise.fresh_budget, 0);
+        EXPECT_GT(noise.min_budget, 0);
+        EXPECT_LE(noise.min_budget, noise.mean_budget);
+        EXPECT_LE(noise.mean_budget, noise.fresh_budget);
+        EXPECT_GE(noise.mean_consumed(), 0);
+
+        rache.set_noise_sampling(0);
+        rache.encrypt(1, destination);
+        EXPECT_EQ(rache.noise_stats().samples, 3u);
+        EXPECT_THROW(Rache(seal::scheme_type::ckks).set_noise_sampling(1), std::invalid_argument);
+    }
+
+    // test that a refreshed cache keeps composing the same values, in the background too
+    TEST(RacheEncryptionTest, RefreshesCache) {
+        Rache rache(seal::scheme_type::bgv);
+        rache.precompute_randomizers(4);
+        rache.set_memo(8);
+
+        seal::Ciphertext before, destination;
+        seal::Plaintext plain;
+        rache.encrypt(500, before);
+        rache.refresh_cache();
+        EXPECT_EQ(rache.noise_stats().refreshes, 1u);
+        EXPECT_EQ(rache.memo_stats().size, 0u);
+
+        rache.encrypt(500, destination);
+        rache.decrypt(destination, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(500));
+        rache.decrypt(before, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(500));
+
+        // encryptions keep going while the cache is swapped under them
+        EXPECT_THROW(rache.start_refresh(std::chrono::milliseconds(0)), std::invalid_argument);
+        rache.start_refresh(std::chrono::milliseconds(1));
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        uint64_t value = 0;
+        while (rache.noise_stats().refreshes < 3 && std::chrono::steady_clock::now() < deadline) {
+            value = (value * 31 + 7) % 1024;
+            rache.encrypt(value, destination);
+            rache.decrypt(destination, plain);
+            ASSERT_EQ(plain.to_string(), uint64_to_hex_string(value));
+        }
+        rache.stop_refresh();
+        EXPECT_GE(rache.noise_stats().refreshes, 3u);
+
+        // destroying an object that is still refreshing stops and waits for the thread
+        std::unique_ptr<Rache> refreshing(new Rache(seal::scheme_type::bgv, 4));
+        refreshing->start_refresh(std::chrono::milliseconds(1));
+        while (refreshing->noise_stats().refreshes < 1 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        EXPECT_NO_THROW(refreshing.reset());
+    }
+
+    // test that window tables are sized to the budget and compose correctly
+    TEST(RacheEncryptionTest, ComposesWithWindows) {
+        Rache rache(seal::scheme_type::bfv, 7, 4);
+        EXPECT_EQ(rache.precompute_windows(0), 1);
+
+        size_t width = rache.precompute_windows(1 << 20);
+        EXPECT_GT(width, 1);
+
+        seal::Ciphertext destination;
+        for (double value : {0, 1, 3, 4, 255, 1000, 4096, 16383}) {
+            seal::Plaintext plain;
+            rache.encrypt(value, destination);
+            rache.decrypt(destination, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+        }
+    }
+
+    // test that balanced digits decrypt correctly, with and without windows
+    TEST(RacheEncryptionTest, ComposesBalancedDigits) {
+        for (uint32_t radix : {2, 3, 4}) {
+            Rache rache(seal::scheme_type::bfv, 7, radix);
+            rache.set_digit_mode(digit_mode::balanced);
+            double max = pow(radix, 7) - 1;
+
+            for (size_t budget : {0, 1 << 20}) {
+                rache.precompute_windows(budget);
+
+                seal::Ciphertext destination;
+                for (double value : {0.0, 1.0, 2.0, 3.0, 7.0, 11.0, max - 1, max}) {
+                    seal::Plaintext plain;
+                    rache.encrypt(value, destination);
+                    rache.decrypt(destination, plain);
+                    EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+                }
+            }
+        }
+    }
+
+    // test that pooled randomizers keep ciphertexts decrypting to the same value
+    TEST(RacheEncryptionTest, RandomizesFromPool) {
+        Rache rache(seal::scheme_type::bfv);
+        rache.precompute_randomizers(8);
+
+        seal::Ciphertext destination;
+        for (double value : {0, 1, 77, 512, 1023}) {
+            seal::Plaintext plain;
+            rache.encrypt(value, destination);
+            rache.decrypt(destination, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+        }
+    }
+
+    // test that a saved cache loads back with the same keys and radixes
+    TEST(RacheEncryptionTest, SavesAndLoads) {
+        std::string path = testing::TempDir() + "rache_cache.bin";
+        Rache rache(seal::scheme_type::bfv);
+        rache.save(path);
+        auto loaded = Rache::load(path);
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        for (double value : {0, 1, 300, 1023}) {
+            // encrypted by the loaded cache, decrypted with the original key
+            loaded->encrypt(value, destination);
+            rache.decrypt(destination, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+
+            // and the other way around
+            rache.encrypt(value, destination);
+            loaded->decrypt(destination, plain);
+            EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+        }
+
+        loaded->set_growth(false);
+        EXPECT_THROW(loaded->encrypt(1024, destination), std::invalid_argument);
+        std::remove(path.c_str());
+    }
+
+    // test that truncated or inconsistent cache files are rejected instead of read past
+    TEST(RacheEncryptionTest, RejectsCorruptFiles) {
+        std::string path = testing::TempDir() + "rache_cache.bin";
+        std::string corrupt = testing::TempDir() + "rache_corrupt.bin";
+        Rache(seal::scheme_type::bfv).save(path);
+
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        auto write = [&](const std::string &contents) {
+            std::ofstream out(corrupt, std::ios::binary | std::ios::trunc);
+            out.write(contents.data(), contents.size());
+        };
+
+        // cut short inside the cached plaintexts
+        write(bytes.substr(0, bytes.size() - 100));
+        EXPECT_THROW(Rache::load(corrupt), std::invalid_argument);
+
+        // the header claims more cached ciphertexts than the file holds
+        std::string patched = bytes;
+        uint64_t cache_size = uint64_t(1) << 40;
+        patched.replace(24, sizeof(cache_size), reinterpret_cast<const char *>(&cache_size), sizeof(cache_size));
+        write(patched);
+        EXPECT_THROW(Rache::load(corrupt), std::invalid_argument);
+
+        // the header names another scheme than the parameters
+        patched = bytes;
+        uint32_t scheme = static_cast<uint32_t>(seal::scheme_type::ckks);
+        patched.replace(12, sizeof(scheme), reinterpret_cast<const char *>(&scheme), sizeof(scheme));
+        write(patched);
+        EXPECT_THROW(Rache::load(corrupt), std::invalid_argument);
+
+        std::remove(path.c_str());
+        std::remove(corrupt.c_str());
+    }
+
+    // test that Rache runs on smaller, caller-chosen parameters
+    TEST(RacheEncryptionTest, AcceptsParameters) {
+        seal::EncryptionParameters params(seal::scheme_type::bfv);
+        params.set_poly_modulus_degree(8192);
+        params.set_coeff_modulus(seal::CoeffModulus::BFVDefault(8192));
+        params.set_plain_modulus(16384);
+
+        Rache rache(params, 12, 2);
+        EXPECT_EQ(rache.key_context()->params().poly_modulus_degree(), 8192);
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        rache.encrypt(4095, destination);
+        rache.decrypt(destination, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(4095));
+    }
+
+    // test that packed CKKS values land in their own slots, rounded down
+    TEST(RacheEncryptionTest, PacksSlots) {
+        seal::EncryptionParameters params(seal::scheme_type::ckks);
+        params.set_poly_modulus_degree(8192);
+        params.set_coeff_modulus(seal::CoeffModulus::BFVDefault(8192));
+
+        Rache rache(params);
+        EXPECT_EQ(rache.slot_count(), 4096);
+
+        std::vector<double> values(rache.slot_count());
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = (i * 37) % 1000 + 0.25;
+        }
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        std::vector<double> decoded;
+        rache.encrypt(values, destination);
+        rache.decrypt(destination, plain);
+        seal::CKKSEncoder(rache.key_context()->context()).decode(plain, decoded);
+        for (size_t i = 0; i < values.size(); i++) {
+            EXPECT_NEAR(decoded[i], floor(values[i]), 0.01);
+        }
+
+        values.push_back(1);
+        EXPECT_THROW(rache.encrypt(values, destination), std::invalid_argument);
+        EXPECT_THROW(Rache(seal::scheme_type::bfv).encrypt(std::vector<double>{1, 2}, destination), 
+                     std::invalid_argument);
+    }
+
+    // test that packed BFV integers land in their own slots
+    TEST(RacheEncryptionTest, PacksIntegers) {
+        seal::EncryptionParameters params(seal::scheme_type::bfv);
+        params.set_poly_modulus_degree(8192);
+        params.set_coeff_modulus(seal::CoeffModulus::BFVDefault(8192));
+        params.set_plain_modulus(seal::PlainModulus::Batching(8192, 20));
+
+        Rache rache(params, 16, 2);
+        EXPECT_EQ(rache.slot_count(), 8192);
+
+        std::vector<uint64_t> values(rache.slot_count());
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = (i * 7919) % 65536;
+        }
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        std::vector<uint64_t> decoded;
+        rache.encrypt(values, destination);
+        rache.decrypt(destination, plain);
+        seal::BatchEncoder(rache.key_context()->context()).decode(plain, decoded);
+        EXPECT_EQ(decoded, values);
+
+        // past the plain modulus, which no amount of growth helps with
+        values[0] = 1 << 20;
+        EXPECT_THROW(rache.encrypt(values, destination), std::invalid_argument);
+
+        // 16384 is not a batching prime
+        params.set_plain_modulus(16384);
+        EXPECT_THROW(Rache(params).encrypt(std::vector<uint64_t>{1, 2}, destination), std::invalid_argument);
+    }
+
+    // test that the pre-scaled constants compose correctly for BGV's NTT-form ciphertexts,
+    // with and without windows and signed digits
+    TEST(RacheEncryptionTest, ComposesBGVValues) {
+        Rache rache(seal::scheme_type::bgv);
+        seal::Ciphertext destination;
+        for (int round = 0; round < 3; round++) {
+            if (round == 1) {
+                rache.set_digit_mode(digit_mode::balanced);
+            } else if (round == 2) {
+                rache.precompute_windows(1 << 20);
+            }
+
+            for (uint64_t value : {0, 1, 6, 511, 1023}) {
+                seal::Plaintext plain;
+                rache.encrypt(value, destination);
+                rache.decrypt(destination, plain);
+                EXPECT_EQ(plain.to_string(), uint64_to_hex_string(value));
+            }
+        }
+    }
+
+    // test that every phase of encrypt is counted once per value
+    TEST(RacheEncryptionTest, RecordsPhases) {
+        if (!Stats::enabled()) {
+            GTEST_SKIP() << "built without RACHEAL_ENABLE_STATS";
+        }
+
+        Rache rache(seal::scheme_type::bfv, 8);
+        std::vector<seal::Ciphertext> destination;
+        rache.encrypt_batch({1, 2, 3, 100}, destination);
+
+        auto stats = rache.stats();
+        for (auto phase : {"decompose", "compose", "randomize"}) {
+            EXPECT_EQ(stats[phase].calls, 4u);
+        }
+
+        rache.reset_stats();
+        EXPECT_EQ(rache.stats()["randomize"].calls, 0u);
+    }
+
+    // test that encoding temporaries come out of the pool that was set
+    TEST(RacheEncryptionTest, UsesMemoryPool) {
+        Rache rache(seal::scheme_type::ckks, 8);
+        auto pool = seal::MemoryPoolHandle::New();
+        rache.set_memory_pool(pool);
+
+        seal::Ciphertext destination;
+        rache.encrypt(std::vector<double>{1, 2, 3}, destination);
+        EXPECT_GT(pool.alloc_byte_count(), 0u);
+
+        seal::Plaintext plain;
+        std::vector<double> decoded;
+        rache.decrypt(destination, plain);
+        seal::CKKSEncoder(rache.key_context()->context()).decode(plain, decoded);
+        EXPECT_NEAR(decoded[2], 3, 0.5);
+    }
+
+    // test that the same seed randomizes the same way, and a different one doesn't
+    TEST(RacheEncryptionTest, ReproducesSeededRandomness) {
+        Rache rache(seal::scheme_type::bfv, 8);
+        seal::Ciphertext first, second, third;
+
+        rache.set_seed(7);
+        rache.encrypt(100, first);
+        rache.set_seed(7);
+        rache.encrypt(100, second);
+        rache.set_seed(8);
+        rache.encrypt(100, third);
+
+        auto same = [](const seal::Ciphertext &a, const seal::Ciphertext &b) {
+            size_t count = a.size() * a.poly_modulus_degree() * a.coeff_modulus_size();
+            return std::equal(a.data(), a.data() + count, b.data());
+        };
+        EXPECT_TRUE(same(first, second));
+        EXPECT_FALSE(same(first, third));
+    }
+
+    // test that one Rache can be shared by many threads, also while it is being reconfigured
+    TEST(RacheEncryptionTest, EncryptsConcurrently) {
+        Rache rache(seal::scheme_type::bfv, 10);
+        const size_t nb_threads = 8, nb_values = 32;
+
+        std::vector<std::vector<seal::Ciphertext>> results(nb_threads, std::vector<seal::Ciphertext>(nb_values));
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < nb_threads; t++) {
+            threads.emplace_back([&, t] {
+                for (size_t i = 0; i < nb_values; i++) {
+                    rache.encrypt((t * nb_values + i) % 1024, results[t][i]);
+                }
+            });
+        }
+
+        // new snapshots are published while the threads above are encrypting
+        rache.precompute_randomizers(4);
+        rache.set_digit_mode(digit_mode::balanced);
+        rache.precompute_windows(1 << 20);
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (size_t t = 0; t < nb_threads; t++) {
+            for (size_t i = 0; i < nb_values; i++) {
+                seal::Plaintext plain;
+                rache.decrypt(results[t][i], plain);
+                EXPECT_EQ(plain.to_string(), uint64_to_hex_string((t * nb_values + i) % 1024));
+            }
+        }
     }
-} // namespace rachetest
\ No newline at end of file
+} // namespace rachetest
@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+#include "ringbuffer.h"
+#include <thread>
+#include <vector>
+
+using namespace che_utils;
+
+namespace ringbuffertest {
+    // fills up, refuses more, and hands values back in order
+    TEST(BoundedRingTest, RespectsCapacityAndOrder) {
+        BoundedRing<int> ring(3);
+        EXPECT_EQ(ring.capacity(), 4);
+
+        for (int i = 0; i < 4; i++) {
+            EXPECT_TRUE(ring.try_push(i));
+        }
+        EXPECT_FALSE(ring.try_push(4));
+
+        int value;
+        for (int i = 0; i < 4; i++) {
+            ASSERT_TRUE(ring.try_pop(value));
+            EXPECT_EQ(value, i);
+        }
+        EXPECT_FALSE(ring.try_pop(value));
+    }
+
+    // every value pushed by several producers is popped exactly once
+    TEST(BoundedRingTest, HandlesManyProducersAndConsumers) {
+        BoundedRing<int> ring(16);
+        const int per_thread = 10000;
+        std::vector<std::atomic<int>> seen(4 * per_thread);
+        std::atomic<int> popped(0);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < per_thread; i++) {
+                    while (!ring.try_push(t * per_thread + i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+            threads.emplace_back([&] {
+                int value;
+                while (popped.load() < 4 * per_thread) {
+                    if (ring.try_pop(value)) {
+                        seen[value]++;
+                        popped++;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (auto &count : seen) {
+            EXPECT_EQ(count.load(), 1);
+        }
+    }
+} // namespace ringbuffertest
@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+#include "stats.h"
+#include "threadpool.h"
+
+using namespace che_utils;
+
+namespace statstest {
+    // counts from every thread end up in the merged report
+    TEST(StatsTest, MergesThreads) {
+        if (!Stats::enabled()) {
+            GTEST_SKIP() << "built without RACHEAL_ENABLE_STATS";
+        }
+
+        Stats stats({"fast", "slow"});
+        ThreadPool pool(3);
+        pool.parallel_for(1000, [&](int start, int end) {
+            for (int i = start; i < end; i++) {
+                stats.record(0, 10);
+                stats.record(1, 1000);
+            }
+        }, 10);
+
+        auto report = stats.report();
+        EXPECT_EQ(report["fast"].calls, 1000u);
+        EXPECT_EQ(report["fast"].total_ns, 10000u);
+        EXPECT_EQ(report["slow"].calls, 1000u);
+        EXPECT_DOUBLE_EQ(report["slow"].mean_ns(), 1000);
+        EXPECT_THROW(report["missing"], std::invalid_argument);
+    }
+
+    // percentiles land in the power-of-two bucket of the value
+    TEST(StatsTest, BucketsPercentiles) {
+        if (!Stats::enabled()) {
+            GTEST_SKIP() << "built without RACHEAL_ENABLE_STATS";
+        }
+
+        Stats stats({"phase"});
+        for (int i = 0; i < 99; i++) {
+            stats.record(0, 100);
+        }
+        stats.record(0, 100000);
+
+        auto phase = stats.report()["phase"];
+        EXPECT_EQ(phase.percentile_ns(50), 127u);
+        EXPECT_EQ(phase.percentile_ns(100), 131071u);
+        EXPECT_EQ(phase.histogram[7], 99u);
+        EXPECT_EQ(phase.histogram[17], 1u);
+    }
+
+    // a thread cycling through more objects than it keeps handy still records into
+    // one block per object, and objects that are gone don't pile up
+    TEST(StatsTest, CyclesThroughObjects) {
+        if (!Stats::enabled()) {
+            GTEST_SKIP() << "built without RACHEAL_ENABLE_STATS";
+        }
+
+        for (int round = 0; round < 10; round++) {
+            std::vector<std::unique_ptr<Stats>> objects;
+            for (int i = 0; i < 40; i++) {
+                objects.emplace_back(new Stats({"phase"}));
+            }
+            for (int rep = 0; rep < 100; rep++) {
+                for (auto &stats : objects) {
+                    stats->record(0, 3);
+                }
+            }
+            for (auto &stats : objects) {
+                EXPECT_EQ(stats->report()["phase"].calls, 100u);
+                EXPECT_EQ(stats->report()["phase"].total_ns, 300u);
+            }
+        }
+    }
+
+    TEST(StatsTest, Resets) {
+        Stats stats({"phase"});
+        stats.record(0, 5);
+        stats.reset();
+        stats.record(0, 7);
+
+        auto phase = stats.report()["phase"];
+        EXPECT_EQ(phase.calls, Stats::enabled() ? 1u : 0u);
+        EXPECT_EQ(phase.total_ns, Stats::enabled() ? 7u : 0u);
+    }
+} // namespace statstest
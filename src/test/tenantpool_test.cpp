@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+#include "racheal.h"
+#include "inche.h"
+#include "tenantpool.h"
+#include "utils.h"
+
+using namespace racheal;
+using namespace inche;
+using namespace che_utils;
+
+namespace tenantpooltest {
+    seal::EncryptionParameters small_params() {
+        seal::EncryptionParameters params(seal::scheme_type::bfv);
+        params.set_poly_modulus_degree(8192);
+        params.set_coeff_modulus(seal::CoeffModulus::BFVDefault(8192));
+        params.set_plain_modulus(16384);
+        return params;
+    }
+
+    // objects built from one key context can decrypt each other's ciphertexts
+    TEST(KeyContextTest, SharesKeysBetweenObjects) {
+        auto keys = std::make_shared<const KeyContext>(small_params());
+        Rache rache(keys);
+        Inche inche(keys);
+        EXPECT_EQ(rache.key_context(), inche.key_context());
+
+        seal::Ciphertext destination;
+        seal::Plaintext plain;
+        rache.encrypt(300, destination);
+        inche.decrypt(destination, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(300));
+
+        inche.encrypt(42, destination);
+        rache.decrypt(destination, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(42));
+    }
+
+    // the same tenant gets the same object back, different tenants get different keys
+    TEST(TenantPoolTest, CachesPerTenant) {
+        TenantPool pool(small_params(), SIZE_MAX, 4);
+        auto a = pool.get("a");
+        auto b = pool.get("b");
+        EXPECT_EQ(a, pool.get("a"));
+        EXPECT_NE(a->key_context(), b->key_context());
+        EXPECT_EQ(&a->key_context()->context(), &b->key_context()->context());
+        EXPECT_EQ(pool.size(), 2);
+        EXPECT_GT(pool.memory_usage(), 0);
+    }
+
+    // least recently used tenants are dropped once over budget, but keep their keys
+    TEST(TenantPoolTest, EvictsLeastRecentlyUsed) {
+        TenantPool pool(small_params(), 1, 4);
+        seal::Ciphertext before;
+        pool.get("a")->encrypt(3, before);
+        auto b = pool.get("b");
+        EXPECT_EQ(pool.size(), 1);
+        EXPECT_EQ(pool.evictions(), 1);
+
+        // rebuilt on the next get, under the same keys
+        auto a = pool.get("a");
+        seal::Plaintext plain;
+        a->decrypt(before, plain);
+        EXPECT_EQ(plain.to_string(), uint64_to_hex_string(3));
+        EXPECT_NE(a->key_context(), b->key_context());
+    }
+} // namespace tenantpooltest
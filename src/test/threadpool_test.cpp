@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include "threadpool.h"
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace che_utils;
+
+namespace threadpooltest {
+    // every index should be visited exactly once, whatever the grain size
+    TEST(ThreadPoolTest, CoversEveryIndexOnce) {
+        ThreadPool pool(4);
+        for (unsigned grain : {0u, 1u, 7u, 1000u}) {
+            std::vector<std::atomic<int>> hits(1000);
+            pool.parallel_for(hits.size(), [&](int start, int end) {
+                for (int i = start; i < end; i++) {
+                    hits[i]++;
+                }
+            }, grain);
+
+            for (auto &hit : hits) {
+                EXPECT_EQ(hit.load(), 1);
+            }
+        }
+    }
+
+    // parallel_for inside parallel_for must not deadlock
+    TEST(ThreadPoolTest, HandlesNestedLoops) {
+        ThreadPool pool(2);
+        std::atomic<int> total(0);
+        pool.parallel_for(16, [&](int start, int end) {
+            for (int i = start; i < end; i++) {
+                pool.parallel_for(64, [&](int s, int e) {
+                    total += e - s;
+                }, 4);
+            }
+        }, 1);
+
+        EXPECT_EQ(total.load(), 16 * 64);
+    }
+
+    // exceptions thrown on a worker are passed back to the caller
+    TEST(ThreadPoolTest, RethrowsExceptions) {
+        ThreadPool pool(2);
+        EXPECT_THROW(pool.parallel_for(100, [](int start, int end) {
+            if (start <= 50 && 50 < end) {
+                throw std::invalid_argument("bad chunk");
+            }
+        }, 10), std::invalid_argument);
+    }
+
+    // a caller left waiting on someone else's chunk sleeps instead of spinning
+    TEST(ThreadPoolTest, SleepsWhileWaiting) {
+        auto cpu_seconds = [] {
+            timespec now;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+            return now.tv_sec + now.tv_nsec / 1e9;
+        };
+
+        // the caller runs chunk 0, which only returns once the worker has chunk 1
+        ThreadPool pool(1);
+        std::atomic<bool> started(false);
+        double before = cpu_seconds();
+        pool.parallel_for(2, [&](int start, int) {
+            if (start == 1) {
+                started = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            } else {
+                while (!started) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        }, 1);
+        EXPECT_LT(cpu_seconds() - before, 0.1);
+    }
+} // namespace threadpooltest
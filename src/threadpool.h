@@ -0,0 +1,302 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace che_utils {
+    /**
+     * A persistent pool of worker threads, each owning its own task queue. Workers
+     * pop from the back of their own queue and steal from the front of the others
+     * when they run dry, so uneven chunks still keep every core busy. Threads that
+     * wait on a parallel_for help run queued tasks, so nested calls cannot deadlock.
+     */
+    class ThreadPool {
+    public:
+        /**
+         * @brief Starts the worker threads.
+         *
+         * @param nb_threads number of workers, 0 picks hardware_concurrency() - 1
+         *        (the calling thread always takes part in parallel_for)
+         */
+        explicit ThreadPool(unsigned nb_threads = 0)
+            : ThreadPool(nb_threads == 0 ? default_workers() : nb_threads, exact_size()) {}
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> guard(sleep_lock);
+                stopping = true;
+            }
+            wake.notify_all();
+
+            for (auto &worker : workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * @brief The process-wide pool shared by Rache, Inche and the benchmark drivers.
+         */
+        static ThreadPool &global() {
+            unsigned nb_threads = global_size();
+            static ThreadPool pool(nb_threads == 0 ? default_workers() : nb_threads - 1, exact_size());
+            return pool;
+        }
+
+        /**
+         * @brief Sets how many threads the global pool's loops run on, counting the
+         *        calling thread, so 1 keeps everything on the caller. Only has an
+         *        effect before global() is first used.
+         *
+         * @param nb_threads total threads, 0 picks hardware_concurrency()
+         */
+        static void set_global_size(unsigned nb_threads) {
+            global_size() = nb_threads;
+        }
+
+        /**
+         * @brief Number of worker threads, not counting callers.
+         */
+        unsigned size() const {
+            return workers.size();
+        }
+
+        /**
+         * @brief Queues a task. Tasks submitted from a worker go to that worker's own
+         *        queue, everything else is spread round-robin.
+         */
+        void submit(std::function<void ()> task) {
+            if (workers.empty()) {
+                task();
+                return;
+            }
+
+            auto &self = current();
+            unsigned home = self.pool == this
+                ? self.index
+                : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+            {
+                std::lock_guard<std::mutex> guard(queues[home]->lock);
+                queues[home]->tasks.push_back(std::move(task));
+            }
+            pending.fetch_add(1, std::memory_order_release);
+
+            // taking the lock orders this wakeup after a sleeping worker's check
+            { std::lock_guard<std::mutex> guard(sleep_lock); }
+            wake.notify_one();
+        }
+
+        /**
+         * @brief Runs one queued task on the calling thread, if there is any.
+         *
+         * @return true if a task was run
+         */
+        bool run_pending_task() {
+            std::function<void ()> task;
+            auto &self = current();
+            unsigned home = self.pool == this ? self.index : 0;
+            if (!pop_task(home, task)) {
+                return false;
+            }
+
+            task();
+            return true;
+        }
+
+        /**
+         * @brief Splits [0, nb_elements) into chunks of grain_size elements and runs
+         *        them across the pool, blocking until all of them are done. The first
+         *        exception thrown by a chunk is rethrown here.
+         *
+         * @param nb_elements size of your for loop
+         * @param functor(start,end) processes the indices [start, end)
+         * @param grain_size elements per chunk, 0 picks about four chunks per thread
+         */
+        void parallel_for(unsigned nb_elements,
+                          const std::function<void (int start, int end)> &functor,
+                          unsigned grain_size = 0) {
+            if (nb_elements == 0) {
+                return;
+            }
+
+            unsigned nb_threads = size() + 1;
+            if (grain_size == 0) {
+                grain_size = std::max(1u, nb_elements / (4 * nb_threads));
+            }
+
+            // not worth waking anybody up for
+            if (workers.empty() || nb_elements <= grain_size) {
+                functor(0, nb_elements);
+                return;
+            }
+
+            unsigned nb_chunks = (nb_elements + grain_size - 1) / grain_size;
+            std::atomic<unsigned> remaining(nb_chunks);
+            std::exception_ptr error;
+            std::mutex error_lock;
+
+            auto run_chunk = [&](unsigned chunk) {
+                int start = chunk * grain_size;
+                int end = std::min(nb_elements, (chunk + 1) * grain_size);
+                try {
+                    functor(start, end);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(error_lock);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+
+                // the caller may return as soon as the count hits zero, taking this
+                // closure with it, so only the pool is touched afterwards
+                ThreadPool *pool = this;
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    pool->notify_sleepers();
+                }
+            };
+
+            for (unsigned chunk = 1; chunk < nb_chunks; chunk++) {
+                submit([&run_chunk, chunk] { run_chunk(chunk); });
+            }
+            run_chunk(0);
+
+            // help out while there is anything to run, this is what makes nesting safe;
+            // once the queues are empty, sleep until the last chunk is done or a nested
+            // loop queues more work
+            while (remaining.load(std::memory_order_acquire) > 0) {
+                if (run_pending_task()) {
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> guard(sleep_lock);
+                wake.wait(guard, [&] {
+                    return remaining.load(std::memory_order_acquire) == 0 
+                        || pending.load(std::memory_order_acquire) > 0;
+                });
+            }
+
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        // picks the constructor that takes the worker count as is, 0 included
+        struct exact_size {};
+
+        ThreadPool(unsigned nb_workers, exact_size) {
+            for (unsigned i = 0; i < nb_workers; i++) {
+                queues.emplace_back(new WorkQueue());
+            }
+
+            for (unsigned i = 0; i < nb_workers; i++) {
+                workers.emplace_back([this, i] { worker_loop(i); });
+            }
+        }
+
+        // wakes workers and parallel_for callers to recheck what they wait for
+        void notify_sleepers() {
+            { std::lock_guard<std::mutex> guard(sleep_lock); }
+            wake.notify_all();
+        }
+
+        static unsigned default_workers() {
+            unsigned nb_threads_hint = std::thread::hardware_concurrency();
+            return nb_threads_hint == 0 ? 7 : nb_threads_hint - 1;
+        }
+
+        struct WorkQueue {
+            std::mutex lock;
+            std::deque<std::function<void ()>> tasks;
+        };
+
+        // identifies which pool (if any) the current thread works for
+        struct WorkerSlot {
+            const ThreadPool *pool = nullptr;
+            unsigned index = 0;
+        };
+
+        static unsigned &global_size() {
+            static unsigned nb_threads = 0;
+            return nb_threads;
+        }
+
+        static WorkerSlot &current() {
+            thread_local WorkerSlot slot;
+            return slot;
+        }
+
+        // own queue is LIFO for cache locality, stealing is FIFO
+        bool pop_task(unsigned home, std::function<void ()> &task) {
+            if (pending.load(std::memory_order_acquire) == 0) {
+                return false;
+            }
+
+            for (size_t i = 0; i < queues.size(); i++) {
+                auto &queue = *queues[(home + i) % queues.size()];
+                std::lock_guard<std::mutex> guard(queue.lock);
+                if (queue.tasks.empty()) {
+                    continue;
+                }
+
+                if (i == 0) {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                } else {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            return false;
+        }
+
+        void worker_loop(unsigned index) {
+            current().pool = this;
+            current().index = index;
+
+            while (true) {
+                std::function<void ()> task;
+                if (pop_task(index, task)) {
+                    task();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> guard(sleep_lock);
+                wake.wait(guard, [this] {
+                    return stopping || pending.load(std::memory_order_acquire) > 0;
+                });
+
+                if (stopping && pending.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+            }
+        }
+
+        std::vector<std::unique_ptr<WorkQueue>> queues;
+        std::vector<std::thread> workers;
+
+        // tasks queued but not yet picked up, across all queues
+        std::atomic<size_t> pending{0};
+        std::atomic<unsigned> next_queue{0};
+
+        std::mutex sleep_lock;
+        std::condition_variable wake;
+        bool stopping = false;
+    };
+} // namespace che_utils
+
+#endif
@@ -0,0 +1,186 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include "seal/seal.h"
+#include "racheal.h"
+#include "loader.h"
+
+using namespace std;
+using namespace seal;
+using namespace racheal;
+using namespace che_utils;
+
+/**
+ * Offline parameter tuner for Rache. For a dataset (one value per line) it sweeps
+ * the polynomial modulus degree, radix and cache size, timing encryption of a sample
+ * of the values and checking how far their decryptions land from the encoded value.
+ * The fastest configuration within the required precision is printed last, as JSON.
+ *
+ * Usage: tuner <dataset> [--scheme ckks|bfv|bgv] [--precision max_abs_error]
+ *              [--sample values] [--cache-slack extra_digits]
+ */
+namespace {
+    struct Candidate {
+        size_t degree;
+        uint32_t radix;
+        size_t cache_size;
+        double scale;
+        double throughput;
+        double max_error;
+    };
+
+    const vector<size_t> DEGREES = {8192, 16384, 32768};
+
+    const vector<uint32_t> RADIXES = {2, 3, 4, 8, 16};
+
+    EncryptionParameters make_params(scheme_type scheme, size_t degree) {
+        EncryptionParameters params(scheme);
+        params.set_poly_modulus_degree(degree);
+        params.set_coeff_modulus(CoeffModulus::BFVDefault(degree));
+        if (scheme != scheme_type::ckks) {
+            params.set_plain_modulus(PlainModulus::Batching(degree, 30));
+        }
+        return params;
+    }
+
+    // Rache drops the fractional part, so that is what decryption should give back
+    double decrypted_value(Rache &rache, const SEALContext &context, Ciphertext &ctxt) {
+        Plaintext plain;
+        rache.decrypt(ctxt, plain);
+
+        if (context.key_context_data()->parms().scheme() == scheme_type::ckks) {
+            CKKSEncoder encoder(context);
+            vector<double> decoded;
+            encoder.decode(plain, decoded);
+            return decoded[0];
+        }
+        return plain.coeff_count() == 0 ? 0 : plain[0];
+    }
+
+    Candidate measure(scheme_type scheme, size_t degree, uint32_t radix, size_t cache_size,
+                      const vector<double> &sample) {
+        Rache rache(make_params(scheme, degree), cache_size, radix);
+
+        // an undersized cache should be skipped, not grown in the middle of the timing
+        rache.set_growth(false);
+        auto &context = rache.key_context()->context();
+
+        vector<Ciphertext> ctxts;
+        auto start = chrono::high_resolution_clock::now();
+        rache.encrypt_batch(sample, ctxts);
+        auto stop = chrono::high_resolution_clock::now();
+        double seconds = chrono::duration<double>(stop - start).count();
+
+        double max_error = 0;
+        for (size_t i = 0; i < sample.size(); i++) {
+            double error = fabs(decrypted_value(rache, context, ctxts[i]) - floor(sample[i]));
+            max_error = max(max_error, error);
+        }
+
+        return Candidate { degree, radix, cache_size, rache.get_scale(), sample.size() / seconds, max_error };
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <dataset> [--scheme ckks|bfv|bgv] [--precision max_abs_error]"
+             << " [--sample values] [--cache-slack extra_digits]" << endl;
+        return 1;
+    }
+
+    string filename = argv[1];
+    scheme_type scheme = scheme_type::ckks;
+    double precision = 0.5;
+    size_t sample_size = 256;
+    size_t cache_slack = 1;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        string arg = argv[i + 1];
+        if (flag == "--scheme") {
+            scheme = arg == "bfv" ? scheme_type::bfv : arg == "bgv" ? scheme_type::bgv : scheme_type::ckks;
+        } else if (flag == "--precision") {
+            precision = stod(arg);
+        } else if (flag == "--sample") {
+            sample_size = stoul(arg);
+        } else if (flag == "--cache-slack") {
+            cache_slack = stoul(arg);
+        } else {
+            cerr << "Unknown option: " << flag << endl;
+            return 1;
+        }
+    }
+
+    // only the sample and the largest value are kept, so the dataset can be any size
+    double max_val = -numeric_limits<double>::infinity();
+    vector<double> sample;
+    size_t nb_values = 0;
+    try {
+        DatasetReader reader(filename);
+        vector<double> chunk;
+        while (reader.next(chunk)) {
+            for (double val : chunk) {
+                if (sample.size() < sample_size) {
+                    sample.push_back(val);
+                }
+                max_val = max(max_val, val);
+                nb_values++;
+            }
+        }
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    if (nb_values == 0) {
+        cerr << "No values in " << filename << endl;
+        return 1;
+    }
+
+    // the largest value decides how many digits every configuration needs
+    sample.push_back(max_val);
+
+    cerr << "degree\tradix\tcache\tvalues/s\tmax error" << endl;
+    vector<Candidate> candidates;
+    for (size_t degree : DEGREES) {
+        for (uint32_t radix : RADIXES) {
+            size_t min_cache = max(1.0, floor(log(max(max_val, 1.0)) / log(radix)) + 1);
+            for (size_t cache_size = min_cache; cache_size <= min_cache + cache_slack; cache_size++) {
+                Candidate candidate;
+                try {
+                    candidate = measure(scheme, degree, radix, cache_size, sample);
+                } catch (const exception &e) {
+                    // e.g. a radix power that doesn't fit the plain modulus
+                    cerr << degree << "\t" << radix << "\t" << cache_size << "\tskipped: " << e.what() << endl;
+                    continue;
+                }
+
+                cerr << degree << "\t" << radix << "\t" << cache_size << "\t"
+                     << candidate.throughput << "\t" << candidate.max_error << endl;
+                candidates.push_back(candidate);
+            }
+        }
+    }
+
+    const Candidate *best = nullptr;
+    for (auto &candidate : candidates) {
+        if (candidate.max_error <= precision && (best == nullptr || candidate.throughput > best->throughput)) {
+            best = &candidate;
+        }
+    }
+
+    if (best == nullptr) {
+        cerr << "No configuration met a precision of " << precision << endl;
+        return 2;
+    }
+
+    cout << "{\"degree\": " << best->degree
+         << ", \"radix\": " << best->radix
+         << ", \"cache_size\": " << best->cache_size
+         << ", \"scale_bits\": " << log2(best->scale)
+         << ", \"throughput\": " << best->throughput
+         << ", \"max_error\": " << best->max_error << "}" << endl;
+    return 0;
+}
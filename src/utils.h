@@ -4,11 +4,14 @@
 #include <stddef.h>
 #include <complex>
 #include <seal/seal.h>
+#include "threadpool.h"
 
 namespace che_utils {
     /**
      * @brief Parallelize a basic for loop, should not be used for anything
      *        requiring concurrent access to the same object in any way.
+     *        Work runs on the shared ThreadPool, so no threads are created
+     *        per call.
      * 
      * @param nb_elements size of your for loop
      * @param functor(start,end)
@@ -16,41 +19,21 @@ namespace che_utils {
      * "start" is the first index to process (included) until the index "end"
      * (excluded)
      * @param use_threads enable / disable threads.
+     * @param grain_size number of elements handed out per chunk, loops with
+     *        no more than this many elements run on the calling thread
+     *        (0 picks a size based on the pool size)
      */
     static void parallel_for(unsigned nb_elements,
                              std::function<void (int start, int end)> functor,
-                             bool use_threads = true) {
-        // -------
-        unsigned nb_threads_hint = std::thread::hardware_concurrency();
-        unsigned nb_threads = nb_threads_hint == 0 ? 8 : (nb_threads_hint);
-
-        unsigned batch_size = nb_elements / nb_threads;
-        unsigned batch_remainder = nb_elements % nb_threads;
-
-        std::vector<std::thread> my_threads(nb_threads);
-
-        if(use_threads) {
-            // Multithread execution
-            for(unsigned i = 0; i < nb_threads; ++i) {
-                int start = i * batch_size;
-                my_threads[i] = std::thread(functor, start, start+batch_size);
-            }
-        } else {
+                             bool use_threads = true,
+                             unsigned grain_size = 0) {
+        if(!use_threads) {
             // Single thread execution (for easy debugging)
-            for(unsigned i = 0; i < nb_threads; ++i) {
-                int start = i * batch_size;
-                functor(start, start + batch_size);
-            }
+            functor(0, nb_elements);
+            return;
         }
 
-        // Deform the elements left
-        int start = nb_threads * batch_size;
-        functor(start, start + batch_remainder);
-
-        // Wait for the other thread to finish their task
-        if(use_threads) {
-            std::for_each(my_threads.begin(), my_threads.end(), std::mem_fn(&std::thread::join));
-        }
+        ThreadPool::global().parallel_for(nb_elements, functor, grain_size);
     }
 
     /**
@@ -66,6 +49,16 @@ namespace che_utils {
     inline std::string uint64_to_hex_string(std::uint64_t value) {
         return seal::util::uint_to_hex_string(&value, std::size_t(1));
     }
+
+    /**
+     * Helper function: writes value as the constant coefficient of a plaintext, the same
+     * plaintext as Plaintext(uint64_to_hex_string(value)) without going through a string.
+     * The destination must not be in NTT form.
+     */
+    inline void set_constant_plain(std::uint64_t value, seal::Plaintext &destination) {
+        destination.resize(1);
+        destination[0] = value;
+    }
 } // namespace che_utils
 
 